@@ -0,0 +1,287 @@
+#include "adr_engine.h"
+#include "tx_scheduler.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Demodulator floor (dB) for SF7..SF12
+#define SNR_FLOOR_SF7 -7.5f
+#define SNR_FLOOR_STEP 2.5f
+
+static inline uint32_t addr_hash(uint32_t dev_addr) {
+    uint32_t h = dev_addr * 0x9E3779B1u;
+    return h ^ (h >> 16);
+}
+
+// Highest 125 kHz datarate usable for ADR
+static uint8_t region_max_dr(region_t region) {
+    return region == US915 ? 3 : 5;
+}
+
+// Highest TXPower index (each step is -2 dB from max EIRP)
+static uint8_t region_max_power(region_t region) {
+    switch(region) {
+        case US915:
+        case AU915:
+        case IN865:
+            return 10;
+        default:
+            return 7;
+    }
+}
+
+float adr_required_snr(region_t region, uint8_t dr) {
+    uint8_t sf;
+    uint32_t bw;
+    if(!lora_datarate_params(region, dr, &sf, &bw)) return 0.0f;
+    return SNR_FLOOR_SF7 - SNR_FLOOR_STEP * (sf - 7);
+}
+
+static adr_device_t *find_device(adr_engine_t *engine, uint32_t dev_addr, bool create) {
+    uint32_t pos = addr_hash(dev_addr) & engine->mask;
+    for(uint32_t probe = 0; probe <= engine->mask; probe++) {
+        adr_device_t *d = &engine->devices[pos];
+        if(!d->used) {
+            if(!create) return NULL;
+            memset(d, 0, sizeof(adr_device_t));
+            d->used = 1;
+            d->dev_addr = dev_addr;
+            return d;
+        }
+        if(d->dev_addr == dev_addr) return d;
+        pos = (pos + 1) & engine->mask;
+    }
+    return NULL;
+}
+
+// Initialize ADR Engine
+bool adr_engine_init(adr_engine_t *engine, const adr_config_t *config, uint32_t capacity) {
+    memset(engine, 0, sizeof(adr_engine_t));
+    memcpy(&engine->config, config, sizeof(adr_config_t));
+    if(engine->config.nb_trans == 0) engine->config.nb_trans = 1;
+    if(engine->config.installation_margin_db <= 0.0f) {
+        engine->config.installation_margin_db = ADR_INSTALLATION_MARGIN_DB;
+    }
+    if(engine->config.ch_mask_count == 0 || engine->config.ch_mask_count > ADR_MAX_MASK_BLOCKS) {
+        engine->config.ch_mask_count = adr_default_channel_mask(engine->config.region,
+                                                                engine->config.ch_masks);
+    }
+
+    uint32_t size = 1;
+    while(size < capacity * 2) size <<= 1;
+
+    engine->devices = calloc(size, sizeof(adr_device_t));
+    if(!engine->devices) return false;
+    engine->mask = size - 1;
+    return true;
+}
+
+void adr_engine_free(adr_engine_t *engine) {
+    free(engine->devices);
+    engine->devices = NULL;
+}
+
+static void reset_history(adr_device_t *dev) {
+    dev->head = 0;
+    dev->count = 0;
+    dev->rssi_sum = 0;
+    dev->max_front = 0;
+    dev->max_len = 0;
+}
+
+// Append a sample; evicts the oldest once the ring is full
+static void push_sample(adr_device_t *dev, int8_t snr, int16_t rssi) {
+    uint8_t pos = dev->head;
+
+    if(dev->count == ADR_HISTORY) {
+        dev->rssi_sum -= dev->rssi[pos];
+        if(dev->max_len > 0 && dev->max_q[dev->max_front] == pos) {
+            dev->max_front = (dev->max_front + 1) % ADR_HISTORY;
+            dev->max_len--;
+        }
+    } else {
+        dev->count++;
+    }
+
+    dev->snr[pos] = snr;
+    dev->rssi[pos] = rssi;
+    dev->rssi_sum += rssi;
+
+    // Drop samples that can never be the maximum again
+    while(dev->max_len > 0) {
+        uint8_t back = (dev->max_front + dev->max_len - 1) % ADR_HISTORY;
+        if(dev->snr[dev->max_q[back]] > snr) break;
+        dev->max_len--;
+    }
+    dev->max_q[(dev->max_front + dev->max_len) % ADR_HISTORY] = pos;
+    dev->max_len++;
+
+    dev->head = (pos + 1) % ADR_HISTORY;
+}
+
+float adr_max_snr(const adr_device_t *dev) {
+    if(dev->max_len == 0) return -INFINITY;
+    return dev->snr[dev->max_q[dev->max_front]];
+}
+
+float adr_mean_rssi(const adr_device_t *dev) {
+    return dev->count ? (float)dev->rssi_sum / dev->count : 0.0f;
+}
+
+// Semtech ADR: convert spare margin into datarate steps, then power steps
+static bool evaluate(adr_engine_t *engine, adr_device_t *dev) {
+    const adr_config_t *cfg = &engine->config;
+    uint8_t max_dr = region_max_dr(cfg->region);
+    uint8_t max_power = region_max_power(cfg->region);
+
+    float margin = adr_max_snr(dev) - adr_required_snr(cfg->region, dev->dr)
+                   - cfg->installation_margin_db;
+    int steps = (int)floorf(margin / ADR_STEP_DB);
+
+    uint8_t dr = dev->dr;
+    uint8_t power = dev->tx_power;
+
+    while(steps > 0 && dr < max_dr) {
+        dr++;
+        steps--;
+    }
+    while(steps > 0 && power < max_power) {
+        power++;
+        steps--;
+    }
+    while(steps < 0 && power > 0) {
+        power--;
+        steps++;
+    }
+
+    engine->evaluations++;
+    if(dr == dev->dr && power == dev->tx_power) return false;
+
+    dev->target_dr = dr;
+    dev->target_power = power;
+    return true;
+}
+
+/**
+ * Feed one uplink into the engine
+ *
+ * @param engine ADR engine
+ * @param dev_addr Device address
+ * @param dr Datarate the uplink was received on
+ * @param snr Uplink SNR (dB)
+ * @param rssi Uplink RSSI (dBm)
+ * @param adr_enabled ADR bit from FCtrl
+ * @return Device state if a LinkADRReq should be sent, else NULL
+ */
+adr_device_t *adr_engine_on_uplink(adr_engine_t *engine, uint32_t dev_addr, uint8_t dr,
+                                   int8_t snr, int16_t rssi, bool adr_enabled) {
+    adr_device_t *dev = find_device(engine, dev_addr, true);
+    if(!dev) return NULL;
+
+    // A datarate change we did not order invalidates the history
+    if(dev->count > 0 && dr != dev->dr && !(dev->pending && dr == dev->target_dr)) {
+        reset_history(dev);
+    }
+    dev->dr = dr;
+    push_sample(dev, snr, rssi);
+
+    if(!adr_enabled) return NULL;
+    if(dev->pending) return dev;    // Retry until LinkADRAns arrives
+    if(dev->count < ADR_HISTORY) return NULL;
+
+    if(evaluate(engine, dev)) {
+        dev->pending = 1;
+        engine->changes++;
+        return dev;
+    }
+    return NULL;
+}
+
+/**
+ * ChMask block matching the channels a device has after a join accept
+ * without CFList. Enabling a channel the device does not know makes it NACK
+ * the whole LinkADRReq, so the mask must not exceed the region's defaults.
+ * US915/AU915 devices start with all 72 channels: the block first switches
+ * every 125 kHz channel off (ChMaskCntl 7), then enables sub-band 1.
+ *
+ * @param region Regional frequency plan
+ * @param masks Receives up to ADR_MAX_MASK_BLOCKS masks, in sending order
+ * @return Number of masks
+ */
+uint8_t adr_default_channel_mask(region_t region, adr_ch_mask_t *masks) {
+    switch(region) {
+        case US915:
+        case AU915:
+            masks[0].ch_mask_cntl = 7;      // 125 kHz channels off, ChMask covers 64-71
+            masks[0].ch_mask = 0x0000;
+            masks[1].ch_mask_cntl = 0;      // 8-channel gateway: channels 0-7
+            masks[1].ch_mask = 0x00FF;
+            return 2;
+        case AS923:
+            masks[0].ch_mask_cntl = 0;
+            masks[0].ch_mask = 0x0003;      // 923.2 / 923.4 MHz
+            return 1;
+        case EU868:
+        case IN865:
+        default:
+            masks[0].ch_mask_cntl = 0;
+            masks[0].ch_mask = 0x0007;      // Three mandatory join channels
+            return 1;
+    }
+}
+
+/**
+ * Serialize the LinkADRReq block for FOpts; the device applies DR, TXPower
+ * and NbTrans from the last command and answers every command alike
+ *
+ * @param engine ADR engine
+ * @param dev Device with a pending change
+ * @param out Receives up to ADR_LINK_ADR_REQ_MAX_LEN bytes
+ * @return Bytes written
+ */
+size_t adr_build_link_adr_req(const adr_engine_t *engine, adr_device_t *dev, uint8_t *out) {
+    const adr_config_t *cfg = &engine->config;
+    size_t len = 0;
+    for(uint8_t i = 0; i < cfg->ch_mask_count; i++) {
+        const adr_ch_mask_t *m = &cfg->ch_masks[i];
+        out[len++] = ADR_CID_LINK_ADR_REQ;
+        out[len++] = (uint8_t)((dev->target_dr << 4) | (dev->target_power & 0x0F));
+        out[len++] = m->ch_mask & 0xFF;
+        out[len++] = m->ch_mask >> 8;
+        out[len++] = (uint8_t)((m->ch_mask_cntl << 4) | (cfg->nb_trans & 0x0F));
+    }
+    dev->commands_sent++;
+    return len;
+}
+
+// Apply the device's LinkADRAns; rejected requests keep the old settings
+void adr_engine_on_link_adr_ans(adr_engine_t *engine, uint32_t dev_addr, uint8_t status) {
+    adr_device_t *dev = find_device(engine, dev_addr, false);
+    if(!dev || !dev->pending) return;
+
+    const uint8_t all = ADR_ANS_CHMASK_ACK | ADR_ANS_DR_ACK | ADR_ANS_POWER_ACK;
+    if((status & all) == all) {
+        dev->dr = dev->target_dr;
+        dev->tx_power = dev->target_power;
+    }
+    dev->pending = 0;
+    reset_history(dev);
+}
+
+void adr_engine_forget(adr_engine_t *engine, uint32_t dev_addr) {
+    adr_device_t *dev = find_device(engine, dev_addr, false);
+    if(!dev) return;
+
+    // Backward-shift deletion keeps probe chains intact
+    uint32_t hole = (uint32_t)(dev - engine->devices);
+    uint32_t pos = (hole + 1) & engine->mask;
+    while(engine->devices[pos].used) {
+        uint32_t home = addr_hash(engine->devices[pos].dev_addr) & engine->mask;
+        if(((pos - home) & engine->mask) >= ((pos - hole) & engine->mask)) {
+            engine->devices[hole] = engine->devices[pos];
+            hole = pos;
+        }
+        pos = (pos + 1) & engine->mask;
+    }
+    engine->devices[hole].used = 0;
+}
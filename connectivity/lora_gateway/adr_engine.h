@@ -0,0 +1,90 @@
+#ifndef ADR_ENGINE_H
+#define ADR_ENGINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "lora_protocol.h"
+
+// Gateway-Side Adaptive Data Rate
+// Keeps the last ADR_HISTORY uplinks per device and derives the fastest
+// datarate / lowest TX power that still leaves ADR_INSTALLATION_MARGIN_DB
+// of link margin (Semtech network-server algorithm). Each uplink costs O(1):
+// max SNR over the window is tracked with a monotonic deque.
+
+#define ADR_HISTORY 20
+#define ADR_INSTALLATION_MARGIN_DB 10.0f
+#define ADR_STEP_DB 3.0f
+#define ADR_CID_LINK_ADR_REQ 0x03
+#define ADR_CID_LINK_ADR_ANS 0x03
+#define ADR_LINK_ADR_REQ_LEN 5        // CID + 4 payload bytes
+#define ADR_MAX_MASK_BLOCKS 2         // LinkADRReq commands per channel-mask block
+#define ADR_LINK_ADR_REQ_MAX_LEN (ADR_MAX_MASK_BLOCKS * ADR_LINK_ADR_REQ_LEN)
+
+// LinkADRAns status bits
+#define ADR_ANS_CHMASK_ACK 0x01
+#define ADR_ANS_DR_ACK 0x02
+#define ADR_ANS_POWER_ACK 0x04
+
+// One ChMask / ChMaskCntl pair
+typedef struct {
+    uint16_t ch_mask;
+    uint8_t ch_mask_cntl;
+} adr_ch_mask_t;
+
+typedef struct {
+    region_t region;
+    adr_ch_mask_t ch_masks[ADR_MAX_MASK_BLOCKS];   // Applied in order as one block
+    uint8_t ch_mask_count;        // 0 = region defaults
+    uint8_t nb_trans;             // Repetitions per uplink (1 = none)
+    float installation_margin_db;
+} adr_config_t;
+
+typedef struct {
+    uint32_t dev_addr;
+    uint8_t used;
+
+    // Ring of recent link statistics
+    int8_t snr[ADR_HISTORY];
+    int16_t rssi[ADR_HISTORY];
+    uint8_t head;                 // Next write position
+    uint8_t count;
+    int32_t rssi_sum;
+
+    // Monotonic deque of ring positions, SNR non-increasing front to back
+    uint8_t max_q[ADR_HISTORY];
+    uint8_t max_front;
+    uint8_t max_len;
+
+    uint8_t dr;                   // Datarate of the last uplink
+    uint8_t tx_power;             // TXPower index believed in use
+    uint8_t target_dr;
+    uint8_t target_power;
+    uint8_t pending;              // LinkADRReq waiting for a downlink slot / answer
+    uint32_t commands_sent;
+} adr_device_t;
+
+typedef struct {
+    adr_config_t config;
+    adr_device_t *devices;
+    uint32_t mask;
+    uint32_t evaluations;
+    uint32_t changes;
+} adr_engine_t;
+
+// Engine API
+bool adr_engine_init(adr_engine_t *engine, const adr_config_t *config, uint32_t capacity);
+void adr_engine_free(adr_engine_t *engine);
+adr_device_t *adr_engine_on_uplink(adr_engine_t *engine, uint32_t dev_addr, uint8_t dr,
+                                   int8_t snr, int16_t rssi, bool adr_enabled);
+size_t adr_build_link_adr_req(const adr_engine_t *engine, adr_device_t *dev, uint8_t *out);
+void adr_engine_on_link_adr_ans(adr_engine_t *engine, uint32_t dev_addr, uint8_t status);
+void adr_engine_forget(adr_engine_t *engine, uint32_t dev_addr);
+uint8_t adr_default_channel_mask(region_t region, adr_ch_mask_t *masks);
+
+// Link statistics
+float adr_max_snr(const adr_device_t *dev);
+float adr_mean_rssi(const adr_device_t *dev);
+float adr_required_snr(region_t region, uint8_t dr);
+
+#endif // ADR_ENGINE_H
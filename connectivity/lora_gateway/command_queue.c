@@ -0,0 +1,238 @@
+#include "command_queue.h"
+#include <string.h>
+
+// True if a should leave the queue before b
+static inline bool ranks_before(const queued_command_t *a, const queued_command_t *b) {
+    if(a->cmd.priority != b->cmd.priority) return a->cmd.priority > b->cmd.priority;
+    if(a->cmd.zone != b->cmd.zone) return a->cmd.zone < b->cmd.zone;
+    return (int32_t)(a->seq - b->seq) < 0;
+}
+
+static void sift_up(command_queue_t *q, size_t i) {
+    queued_command_t entry = q->heap[i];
+    while(i > 0) {
+        size_t parent = (i - 1) / 2;
+        if(!ranks_before(&entry, &q->heap[parent])) break;
+        q->heap[i] = q->heap[parent];
+        i = parent;
+    }
+    q->heap[i] = entry;
+}
+
+static void sift_down(command_queue_t *q, size_t i) {
+    queued_command_t entry = q->heap[i];
+    while(1) {
+        size_t child = 2 * i + 1;
+        if(child >= q->count) break;
+        if(child + 1 < q->count && ranks_before(&q->heap[child + 1], &q->heap[child])) child++;
+        if(!ranks_before(&q->heap[child], &entry)) break;
+        q->heap[i] = q->heap[child];
+        i = child;
+    }
+    q->heap[i] = entry;
+}
+
+// Re-establish heap order after heap[i] changed
+static void reheap(command_queue_t *q, size_t i) {
+    if(i > 0 && ranks_before(&q->heap[i], &q->heap[(i - 1) / 2])) {
+        sift_up(q, i);
+    } else {
+        sift_down(q, i);
+    }
+}
+
+static void remove_at(command_queue_t *q, size_t i) {
+    q->count--;
+    if(i == q->count) return;
+    q->heap[i] = q->heap[q->count];
+    reheap(q, i);
+}
+
+// Lowest-ranked entry is one of the leaves
+static size_t lowest_index(const command_queue_t *q) {
+    size_t lowest = q->count / 2;
+    for(size_t i = lowest + 1; i < q->count; i++) {
+        if(ranks_before(&q->heap[lowest], &q->heap[i])) lowest = i;
+    }
+    return lowest;
+}
+
+// Heap index of the queued command for a device and zone, -1 if none
+static int find_command(const command_queue_t *q, uint32_t dev_addr, uint8_t zone) {
+    for(size_t i = 0; i < q->count; i++) {
+        if(q->heap[i].dev_addr == dev_addr && q->heap[i].cmd.zone == zone) return (int)i;
+    }
+    return -1;
+}
+
+// Add a new entry, evicting a lower-priority command when full (lock held)
+static bool insert(command_queue_t *q, const queued_command_t *entry) {
+    if(q->count == COMMAND_QUEUE_CAPACITY) {
+        size_t lowest = lowest_index(q);
+        if(!ranks_before(entry, &q->heap[lowest]) ||
+           entry->cmd.priority == q->heap[lowest].cmd.priority) {
+            q->stats.rejected++;
+            return false;
+        }
+        remove_at(q, lowest);
+        q->stats.evicted++;
+    }
+    q->heap[q->count++] = *entry;
+    sift_up(q, q->count - 1);
+    return true;
+}
+
+// Initialize Command Queue
+void command_queue_init(command_queue_t *q) {
+    memset(q, 0, sizeof(command_queue_t));
+    pthread_mutex_init(&q->lock, NULL);
+}
+
+void command_queue_destroy(command_queue_t *q) {
+    pthread_mutex_destroy(&q->lock);
+}
+
+/**
+ * Queue a command from the cloud (producer side, may block briefly)
+ *
+ * @param q Command queue
+ * @param dev_addr End device the command is addressed to
+ * @param cmd Decoded irrigation command
+ * @param now_ms Arrival time, used for command-to-air latency
+ * @return How the command was absorbed
+ */
+command_push_result_t command_queue_push(command_queue_t *q, uint32_t dev_addr,
+                                         const irrigation_command_t *cmd, uint32_t now_ms) {
+    command_push_result_t result = COMMAND_QUEUED;
+    queued_command_t entry = {
+        .cmd = *cmd,
+        .dev_addr = dev_addr,
+        .enqueued_ms = now_ms
+    };
+
+    pthread_mutex_lock(&q->lock);
+    entry.seq = q->next_seq++;
+
+    int slot = find_command(q, dev_addr, cmd->zone);
+    if(slot >= 0) {
+        queued_command_t *queued = &q->heap[slot];
+        if(queued->cmd.duration == cmd->duration && queued->cmd.priority == cmd->priority) {
+            q->stats.duplicates++;
+            result = COMMAND_DUPLICATE;
+        } else {
+            // Latest command for the zone wins; latency runs from its arrival
+            *queued = entry;
+            reheap(q, (size_t)slot);
+            q->stats.superseded++;
+            result = COMMAND_SUPERSEDED;
+        }
+    } else if(insert(q, &entry)) {
+        q->stats.enqueued++;
+    } else {
+        result = COMMAND_REJECTED;
+    }
+
+    pthread_mutex_unlock(&q->lock);
+    return result;
+}
+
+/**
+ * Put back a popped command whose downlink never went on air
+ *
+ * The entry keeps its arrival time and sequence number. A command for the
+ * same device and zone that arrived while this one was in flight is newer
+ * and always wins: the requeued command is then dropped, never the new one.
+ *
+ * @param q Command queue
+ * @param entry Command as returned by command_queue_try_pop
+ * @return COMMAND_QUEUED, COMMAND_STALE or COMMAND_REJECTED (queue full)
+ */
+command_push_result_t command_queue_requeue(command_queue_t *q, const queued_command_t *entry) {
+    command_push_result_t result = COMMAND_QUEUED;
+
+    pthread_mutex_lock(&q->lock);
+    int slot = find_command(q, entry->dev_addr, entry->cmd.zone);
+    if(slot >= 0 && (int32_t)(q->heap[slot].seq - entry->seq) > 0) {
+        q->stats.stale++;
+        result = COMMAND_STALE;
+    } else if(slot >= 0) {
+        q->heap[slot] = *entry;
+        reheap(q, (size_t)slot);
+        q->stats.requeued++;
+    } else if(insert(q, entry)) {
+        q->stats.requeued++;
+    } else {
+        result = COMMAND_REJECTED;
+    }
+
+    pthread_mutex_unlock(&q->lock);
+    return result;
+}
+
+/**
+ * Take the most urgent command for one device without blocking (RX-window path)
+ *
+ * @param q Command queue
+ * @param dev_addr Device whose receive window is about to open
+ * @param out Receives the command and its arrival time
+ * @return False if nothing is queued for the device or the producer holds the lock
+ */
+bool command_queue_try_pop(command_queue_t *q, uint32_t dev_addr, queued_command_t *out) {
+    if(pthread_mutex_trylock(&q->lock) != 0) {
+        __atomic_fetch_add(&q->stats.contended, 1, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    size_t best = q->count;
+    for(size_t i = 0; i < q->count; i++) {
+        if(q->heap[i].dev_addr != dev_addr) continue;
+        if(best == q->count || ranks_before(&q->heap[i], &q->heap[best])) best = i;
+    }
+
+    bool found = best < q->count;
+    if(found) {
+        *out = q->heap[best];
+        remove_at(q, best);
+    }
+
+    pthread_mutex_unlock(&q->lock);
+    return found;
+}
+
+size_t command_queue_size(command_queue_t *q) {
+    pthread_mutex_lock(&q->lock);
+    size_t count = q->count;
+    pthread_mutex_unlock(&q->lock);
+    return count;
+}
+
+// Account the time from cloud arrival to the actual on-air start (lock-free)
+void command_queue_record_air(command_queue_t *q, const queued_command_t *entry, uint32_t air_ms) {
+    uint32_t latency = air_ms - entry->enqueued_ms;
+    command_queue_stats_t *st = &q->stats;
+
+    __atomic_fetch_add(&st->latency_samples, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&st->latency_total_ms, latency, __ATOMIC_RELAXED);
+    uint32_t max = __atomic_load_n(&st->latency_max_ms, __ATOMIC_RELAXED);
+    while(latency > max &&
+          !__atomic_compare_exchange_n(&st->latency_max_ms, &max, latency, true,
+                                       __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+}
+
+void command_queue_get_stats(command_queue_t *q, command_queue_stats_t *out) {
+    pthread_mutex_lock(&q->lock);
+    out->enqueued = q->stats.enqueued;
+    out->duplicates = q->stats.duplicates;
+    out->superseded = q->stats.superseded;
+    out->evicted = q->stats.evicted;
+    out->rejected = q->stats.rejected;
+    out->requeued = q->stats.requeued;
+    out->stale = q->stats.stale;
+    pthread_mutex_unlock(&q->lock);
+
+    // Updated lock-free from the RX-window path
+    out->contended = __atomic_load_n(&q->stats.contended, __ATOMIC_RELAXED);
+    out->latency_samples = __atomic_load_n(&q->stats.latency_samples, __ATOMIC_RELAXED);
+    out->latency_total_ms = __atomic_load_n(&q->stats.latency_total_ms, __ATOMIC_RELAXED);
+    out->latency_max_ms = __atomic_load_n(&q->stats.latency_max_ms, __ATOMIC_RELAXED);
+}
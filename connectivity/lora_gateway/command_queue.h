@@ -0,0 +1,73 @@
+#ifndef COMMAND_QUEUE_H
+#define COMMAND_QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "lora_protocol.h"
+
+// Irrigation Command Queue
+// Bounded max-heap filled by the TTN downlink stream and drained from the
+// RX-window path. Ordered by priority (high first), then zone, then arrival.
+// Every command is addressed to one end device and is only handed out in
+// that device's RX window. At most one command per device and zone: a newer
+// command supersedes the queued one. The queue is small enough that
+// per-device lookups are a linear scan over a few cache lines. The RX-window
+// pop only ever try-locks, so it never blocks on the producer.
+
+#define COMMAND_QUEUE_CAPACITY 64
+
+typedef struct {
+    irrigation_command_t cmd;
+    uint32_t dev_addr;          // Destination end device
+    uint32_t enqueued_ms;
+    uint32_t seq;               // Arrival order, breaks ties
+} queued_command_t;
+
+typedef struct {
+    uint32_t enqueued;
+    uint32_t duplicates;        // Identical to the queued command, ignored
+    uint32_t superseded;        // Replaced a queued command for the same device and zone
+    uint32_t evicted;           // Lower-priority command pushed out when full
+    uint32_t rejected;          // Queue full of higher-priority commands
+    uint32_t requeued;          // Put back after a missed RX window
+    uint32_t stale;             // Not put back: a newer command took its place
+    uint32_t contended;         // try_pop found the lock busy
+
+    // Command-to-air latency
+    uint32_t latency_samples;
+    uint64_t latency_total_ms;
+    uint32_t latency_max_ms;
+} command_queue_stats_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    queued_command_t heap[COMMAND_QUEUE_CAPACITY];
+    size_t count;
+    uint32_t next_seq;
+    command_queue_stats_t stats;
+} command_queue_t;
+
+typedef enum {
+    COMMAND_QUEUED = 0,
+    COMMAND_DUPLICATE = 1,
+    COMMAND_SUPERSEDED = 2,
+    COMMAND_REJECTED = 3,
+    COMMAND_STALE = 4           // Requeue only: superseded while in flight
+} command_push_result_t;
+
+// Queue API
+void command_queue_init(command_queue_t *q);
+void command_queue_destroy(command_queue_t *q);
+command_push_result_t command_queue_push(command_queue_t *q, uint32_t dev_addr,
+                                         const irrigation_command_t *cmd, uint32_t now_ms);
+command_push_result_t command_queue_requeue(command_queue_t *q, const queued_command_t *entry);
+bool command_queue_try_pop(command_queue_t *q, uint32_t dev_addr, queued_command_t *out);
+size_t command_queue_size(command_queue_t *q);
+
+// Latency accounting
+void command_queue_record_air(command_queue_t *q, const queued_command_t *entry, uint32_t air_ms);
+void command_queue_get_stats(command_queue_t *q, command_queue_stats_t *out);
+
+#endif // COMMAND_QUEUE_H
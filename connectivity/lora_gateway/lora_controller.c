@@ -3,15 +3,33 @@
 #include "mesh_routing.h"
 #include "security/aes_lorawan.h"
 #include "security/key_management.h"
+#include "security/device_registry.h"
+#include "security/fcnt_journal.h"
+#include "tx_scheduler.h"
+#include "adr_engine.h"
+#include "command_queue.h"
 #include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define GATEWAY_MAX_DEVICES 4096
+#define JOURNAL_PARTITION "fcnt_journal"
+#define JOIN_ACCEPT_LEN 17               // MHDR | 12 bytes | MIC, no CFList
+#define FCTRL_ADR 0x80
+#define FCTRL_FOPTS_LEN 0x0F
+#define TTN_RETRY_S 5
 
 // LoRa Module Hardware Abstraction
 typedef struct {
     void (*init)(region_t region);
     void (*set_datarate)(uint8_t dr);
+    void (*set_frequency)(uint32_t freq_hz);
     void (*set_tx_power)(uint8_t power);
     bool (*send)(const uint8_t *data, size_t len);
+    // Optional timestamped TX; latches the current frequency and data rate
+    bool (*send_at)(const uint8_t *data, size_t len, uint32_t tx_at_ms);
     int (*receive)(uint8_t *buffer, size_t size, uint32_t timeout);
+    void (*get_rx_meta)(lora_rx_meta_t *meta);   // Metadata of the last received packet
 } lora_driver_t;
 
 // Global Gateway State
@@ -20,6 +38,97 @@ static lora_driver_t lora_driver;
 static uint8_t dev_eui[8] = {0};
 static uint32_t uplink_counter = 0;
 static uint32_t downlink_counter = 0;
+static device_registry_t device_sessions;
+static fcnt_journal_t session_journal;
+static tx_scheduler_t tx_sched;
+static lora_rx_meta_t last_rx_meta;
+static adr_engine_t adr_engine;
+static command_queue_t irrigation_commands;
+static pthread_t ttn_downlink_thread;
+static ttn_uplink_queue_t ttn_uplinks;
+static pthread_t ttn_uplink_thread;
+static uint32_t gateway_tx_freq_hz;      // Region's default channel for own uplinks
+
+// Irrigation commands riding in scheduled downlinks, frame tag = index + 1.
+// Each one occupies a scheduler slot, so the table can never overflow.
+typedef struct {
+    queued_command_t entry;
+    bool used;
+} command_in_flight_t;
+
+static command_in_flight_t commands_in_flight[TX_QUEUE_SIZE];
+
+// Cloud downlink task: keeps the TTN stream open and fills the command queue
+static void *ttn_downlink_task(void *arg) {
+    (void)arg;
+    while(!register_gateway_with_ttn(current_config.region)) {
+        log_warning("TTN registration failed, retrying");
+        sleep(TTN_RETRY_S);
+    }
+    while(1) {
+        if(!process_ttn_downlinks()) {
+            sleep(TTN_RETRY_S);
+        }
+    }
+    return NULL;
+}
+
+// Cloud uplink task: the HTTP round trip never delays the radio loop
+static void *ttn_uplink_task(void *arg) {
+    (void)arg;
+    ttn_uplink_t uplink;
+    while(1) {
+        ttn_uplink_pop(&ttn_uplinks, &uplink);
+        forward_to_ttn(uplink.data, uplink.len);
+    }
+    return NULL;
+}
+
+// Scheduler -> radio adapter
+static bool scheduler_send(void *ctx, const uint8_t *data, size_t len,
+                           uint32_t freq_hz, uint8_t dr, uint32_t tx_at_ms) {
+    (void)ctx;
+    bool ok;
+    lora_driver.set_frequency(freq_hz);
+    lora_driver.set_datarate(dr);
+    if(tx_at_ms != 0 && lora_driver.send_at) {
+        // Radio starts the frame itself when the RX window opens
+        ok = lora_driver.send_at(data, len, tx_at_ms);
+    } else {
+        // Sleep out the TX_LEAD_MS head start instead of spinning
+        int32_t wait_ms = tx_at_ms != 0 ? (int32_t)(tx_at_ms - get_timestamp()) : 0;
+        if(wait_ms > 0) usleep((useconds_t)wait_ms * 1000);
+        ok = lora_driver.send(data, len);
+    }
+    lora_driver.set_frequency(gateway_tx_freq_hz);
+    lora_driver.set_datarate(current_config.datarate);
+    return ok;
+}
+
+static uint32_t track_command(const queued_command_t *command) {
+    for(uint32_t i = 0; i < TX_QUEUE_SIZE; i++) {
+        if(!commands_in_flight[i].used) {
+            commands_in_flight[i].entry = *command;
+            commands_in_flight[i].used = true;
+            return i + 1;
+        }
+    }
+    return TX_TAG_NONE;
+}
+
+// Scheduler -> command queue: latency is measured at the real on-air start;
+// a command whose RX1 and RX2 were both missed goes back to the queue
+static void command_tx_done(void *ctx, uint32_t tag, bool sent, uint32_t air_ms) {
+    (void)ctx;
+    command_in_flight_t *flight = &commands_in_flight[tag - 1];
+    flight->used = false;
+    
+    if(sent) {
+        command_queue_record_air(&irrigation_commands, &flight->entry, air_ms);
+    } else if(command_queue_requeue(&irrigation_commands, &flight->entry) == COMMAND_REJECTED) {
+        log_warning("Command queue full, zone %d dropped", flight->entry.cmd.zone);
+    }
+}
 
 // Initialize LoRa Controller
 void lora_controller_init(lora_driver_t driver, gateway_config_t config) {
@@ -27,12 +136,54 @@ void lora_controller_init(lora_driver_t driver, gateway_config_t config) {
     memcpy(&current_config, &config, sizeof(gateway_config_t));
     
     // Initialize hardware
+    gateway_tx_freq_hz = tx_region_default_freq_hz(config.region);
     lora_driver.init(config.region);
+    lora_driver.set_frequency(gateway_tx_freq_hz);
     lora_driver.set_datarate(config.datarate);
     lora_driver.set_tx_power(config.tx_power);
+    tx_scheduler_init(&tx_sched, config.region, scheduler_send, NULL);
+    tx_scheduler_set_done_hook(&tx_sched, command_tx_done, NULL);
+    
+    // Join accepts carry no CFList: only the region's default channels exist
+    adr_config_t adr_config = {
+        .region = config.region,
+        .nb_trans = 1,
+        .installation_margin_db = ADR_INSTALLATION_MARGIN_DB
+    };
+    adr_config.ch_mask_count = adr_default_channel_mask(config.region, adr_config.ch_masks);
+    if(!adr_engine_init(&adr_engine, &adr_config, GATEWAY_MAX_DEVICES)) {
+        log_error("ADR engine allocation failed");
+    }
+    
+    // Irrigation commands streamed from TTN, drained in RX windows
+    command_queue_init(&irrigation_commands);
+    ttn_set_command_queue(&irrigation_commands);
+    if(pthread_create(&ttn_downlink_thread, NULL, ttn_downlink_task, NULL) != 0) {
+        log_error("TTN downlink task failed to start");
+    }
+    
+    // Received uplinks, forwarded to TTN off the radio loop
+    ttn_uplink_queue_init(&ttn_uplinks);
+    if(pthread_create(&ttn_uplink_thread, NULL, ttn_uplink_task, NULL) != 0) {
+        log_error("TTN uplink task failed to start");
+    }
     
     // Load security keys
     load_activation_keys();
+    if(!device_registry_init(&device_sessions, GATEWAY_MAX_DEVICES)) {
+        // The registry rejects every call from here on: no sessions, no data uplinks
+        log_error("Device registry allocation failed");
+        return;
+    }
+    
+    // Restore sessions and frame counters persisted before the last reset
+    journal_storage_t storage;
+    if(journal_flash_storage_init(&storage, JOURNAL_PARTITION) &&
+       fcnt_journal_open(&session_journal, &storage, GATEWAY_MAX_DEVICES)) {
+        fcnt_journal_restore(&session_journal, &device_sessions);
+    } else {
+        log_error("Frame counter journal unavailable");
+    }
     
     // Join network
     if(config.activation == OTAA) {
@@ -45,33 +196,64 @@ void lora_control_loop() {
     uint8_t rx_buffer[256];
     uint8_t tx_buffer[256];
     
+    uint32_t rx_timeout = 1000;
+    
     while(1) {
-        // Receive packets with timeout
-        int rx_len = lora_driver.receive(rx_buffer, sizeof(rx_buffer), 1000);
+        // Receive packets until the scheduler's next TX event
+        int rx_len = lora_driver.receive(rx_buffer, sizeof(rx_buffer), rx_timeout);
         
         if(rx_len > 0) {
+            lora_driver.get_rx_meta(&last_rx_meta);
             process_received_packet(rx_buffer, rx_len);
         }
         
-        // Periodic uplink transmission
+        // Periodic uplink transmission (queued; sent when airtime budget allows)
         static uint32_t last_tx = 0;
-        if(get_timestamp() - last_tx > current_config.tx_interval) {
-            if(prepare_uplink(tx_buffer, sizeof(tx_buffer)) {
-                lora_driver.send(tx_buffer, sizeof(tx_buffer));
-                last_tx = get_timestamp();
-                uplink_counter++;
+        uint32_t now = get_timestamp();
+        if(now - last_tx > current_config.tx_interval) {
+            size_t tx_len = prepare_uplink(tx_buffer, sizeof(tx_buffer));
+            if(tx_len > 0) {
+                tx_window_t window = {
+                    .freq_hz = gateway_tx_freq_hz,
+                    .dr = current_config.datarate,
+                    .not_before_ms = now,
+                    .deadline_ms = now + current_config.tx_interval
+                };
+                if(tx_scheduler_enqueue(&tx_sched, tx_buffer, tx_len, TX_PRIO_TELEMETRY,
+                                        &window, NULL, TX_TAG_NONE)) {
+                    uplink_counter++;
+                }
+                last_tx = now;
             }
         }
         
         // Handle downlinks
         process_downlinks();
+        
+        // Transmit the most urgent frame that fits its window and duty cycle
+        rx_timeout = tx_scheduler_service(&tx_sched, get_timestamp());
+        
+        // Flush coalesced counter records, compact when space runs low
+        fcnt_journal_maintain(&session_journal);
     }
 }
 
 // Process Received Packet
 void process_received_packet(uint8_t *packet, size_t len) {
-    // Verify MIC first
-    if(!verify_packet_integrity(packet, len)) {
+    lora_header_t *header = (lora_header_t *)packet;
+    
+    // Verify MIC first (data uplinks use the cached per-device session)
+    if(header->mtype == UNCONFIRMED_UP || header->mtype == CONFIRMED_UP) {
+        uint32_t dev_addr, fcnt;
+        memcpy(&dev_addr, header->dev_addr, 4);
+        if(!device_registry_verify_packet(&device_sessions, packet, len, &fcnt)) {
+            log_error("MIC verification failed");
+            return;
+        }
+        device_registry_set_fcnt_up(&device_sessions, dev_addr, fcnt + 1);
+        fcnt_journal_note_fcnt(&session_journal, dev_addr, JOURNAL_DIR_UP, fcnt + 1);
+        queue_rx_window_downlink(packet, dev_addr);
+    } else if(!verify_packet_integrity(packet, len)) {
         log_error("MIC verification failed");
         return;
     }
@@ -80,8 +262,6 @@ void process_received_packet(uint8_t *packet, size_t len) {
     decrypt_payload(packet, len);
     
     // Handle by packet type
-    lora_header_t *header = (lora_header_t *)packet;
-    
     switch(header->mtype) {
         case JOIN_REQUEST:
             handle_join_request(packet);
@@ -90,7 +270,9 @@ void process_received_packet(uint8_t *packet, size_t len) {
         case UNCONFIRMED_UP:
         case CONFIRMED_UP:
             route_mesh_packet(packet, len);
-            forward_to_ttn(packet, len);
+            if(!ttn_queue_uplink(&ttn_uplinks, packet, len)) {
+                log_warning("Uplink too large to forward: %u bytes", (unsigned)len);
+            }
             break;
             
         case JOIN_ACCEPT:
@@ -104,11 +286,118 @@ void process_received_packet(uint8_t *packet, size_t len) {
     }
 }
 
-// Prepare Uplink Data
-bool prepare_uplink(uint8_t *buffer, size_t size) {
+// Walk uplink FOpts for MAC answers the gateway tracks
+static void handle_mac_answers(const uint8_t *fopts, size_t len, uint32_t dev_addr) {
+    size_t i = 0;
+    while(i < len) {
+        uint8_t cid = fopts[i++];
+        switch(cid) {
+            case ADR_CID_LINK_ADR_ANS:
+                if(i >= len) return;
+                adr_engine_on_link_adr_ans(&adr_engine, dev_addr, fopts[i++]);
+                break;
+            case 0x02:    // LinkCheckReq
+            case 0x04:    // DutyCycleAns
+            case 0x08:    // RXTimingSetupAns
+                break;
+            case 0x05:    // RXParamSetupAns
+            case 0x07:    // NewChannelAns
+                i += 1;
+                break;
+            case 0x06:    // DevStatusAns
+                i += 2;
+                break;
+            default:
+                return;   // Unknown length, stop parsing
+        }
+    }
+}
+
+/**
+ * Run ADR for a verified data uplink
+ *
+ * @param packet PHYPayload (MHDR | DevAddr | FCtrl | FCnt | FOpts | ...)
+ * @param dev_addr Device address
+ * @param fopts Receives a LinkADRReq if one is due
+ * @return FOpts length to piggyback on the next downlink (0 = none)
+ */
+size_t handle_adr(const uint8_t *packet, uint32_t dev_addr, uint8_t *fopts) {
+    uint8_t fctrl = packet[5];
+    handle_mac_answers(packet + 8, fctrl & FCTRL_FOPTS_LEN, dev_addr);
+    
+    adr_device_t *dev = adr_engine_on_uplink(&adr_engine, dev_addr, last_rx_meta.datarate,
+                                             last_rx_meta.snr, last_rx_meta.rssi,
+                                             (fctrl & FCTRL_ADR) != 0);
+    if(!dev) return 0;
+    return adr_build_link_adr_req(&adr_engine, dev, fopts);
+}
+
+/**
+ * Answer a verified data uplink in its Class A RX windows
+ * Zone controllers share the cloud command stream: the next queued irrigation
+ * command rides in whichever RX window opens first, with pending MAC
+ * commands piggybacked in FOpts.
+ *
+ * @param packet Uplink PHYPayload
+ * @param dev_addr Device address
+ */
+void queue_rx_window_downlink(const uint8_t *packet, uint32_t dev_addr) {
+    uint8_t fopts[ADR_LINK_ADR_REQ_MAX_LEN];
+    size_t opts_len = handle_adr(packet, dev_addr, fopts);
+    
+    const device_session_t *session = device_registry_find_addr(&device_sessions, dev_addr);
+    device_record_t record;
+    if(!session || !device_registry_snapshot(session, &record)) return;
+    
+    // Never blocks: a busy queue just means no command this window
+    queued_command_t command;
+    bool has_command = command_queue_try_pop(&irrigation_commands, dev_addr, &command);
+    if(opts_len == 0 && !has_command) return;
+    
+    // MHDR | DevAddr | FCtrl | FCnt | FOpts | [FPort | FRMPayload] | MIC
+    uint8_t frame[8 + ADR_LINK_ADR_REQ_MAX_LEN + 1 + sizeof(irrigation_command_t) + 4];
+    uint32_t fcnt = record.fcnt_down;
+    
+    frame[0] = UNCONFIRMED_DOWN << 5;
+    memcpy(frame + 1, &dev_addr, 4);
+    frame[5] = FCTRL_ADR | (uint8_t)opts_len;
+    frame[6] = fcnt & 0xFF;
+    frame[7] = (fcnt >> 8) & 0xFF;
+    memcpy(frame + 8, fopts, opts_len);
+    size_t len = 8 + opts_len;
+    
+    if(has_command) {
+        frame[len++] = TTN_COMMAND_FPORT;
+        memcpy(frame + len, &command.cmd, sizeof(irrigation_command_t));
+        encrypt_payload(frame + len, sizeof(irrigation_command_t), record.app_skey,
+                        dev_addr, fcnt, 1);
+        len += sizeof(irrigation_command_t);
+    }
+    
+    lorawan_compute_mic_sched(frame, len, &session->nwk_sched, dev_addr, fcnt, 1, frame + len);
+    len += 4;
+    
+    // The scheduler reports through command_tx_done() once the frame is sent or dropped
+    uint8_t priority = has_command ? TX_PRIO_COMMAND : TX_PRIO_DOWNLINK;
+    uint32_t tag = has_command ? track_command(&command) : TX_TAG_NONE;
+    if(!tx_scheduler_enqueue_class_a(&tx_sched, frame, len, priority,
+                                     &last_rx_meta, RECEIVE_DELAY1_MS, tag)) {
+        log_warning("Downlink dropped: no airtime");
+        if(tag != TX_TAG_NONE) {
+            command_tx_done(NULL, tag, false, 0);
+        }
+        return;
+    }
+    
+    device_registry_set_fcnt_down(&device_sessions, dev_addr, fcnt + 1);
+    fcnt_journal_note_fcnt(&session_journal, dev_addr, JOURNAL_DIR_DOWN, fcnt + 1);
+}
+
+// Prepare Uplink Data (returns frame length, 0 on failure)
+size_t prepare_uplink(uint8_t *buffer, size_t size) {
     sensor_data_t sensor_data;
     if(!read_sensors(&sensor_data)) {
-        return false;
+        return 0;
     }
     
     lora_header_t header = {
@@ -133,7 +422,7 @@ bool prepare_uplink(uint8_t *buffer, size_t size) {
     // Encrypt payload
     encrypt_payload(buffer + sizeof(header), offset - sizeof(header) - 4);
     
-    return true;
+    return offset;
 }
 
 // Handle Join Requests
@@ -150,6 +439,36 @@ void handle_join_request(uint8_t *packet) {
     uint8_t response[128];
     generate_join_accept(request->dev_nonce, response);
     
-    // Send response
-    lora_driver.send(response, sizeof(response));
+    // Derive and cache session keys once per join
+    // JoinAccept: MHDR | AppNonce(3) | NetID(3) | DevAddr(4) | ...
+    uint32_t dev_addr;
+    memcpy(&dev_addr, response + 7, 4);
+    
+    device_record_t previous;
+    const device_session_t *existing = device_registry_find_eui(&device_sessions, request->dev_eui);
+    bool rejoin = existing && device_registry_snapshot(existing, &previous);
+    
+    const device_session_t *session = device_registry_join(&device_sessions, request->app_eui,
+                                                           request->dev_eui, dev_addr, get_app_key(),
+                                                           (const uint8_t *)&request->dev_nonce);
+    if(!session) {
+        log_warning("Device registry full");
+        return;
+    }
+    
+    // Persist the new session; retire the old DevAddr on rejoin
+    device_record_t record;
+    device_registry_snapshot(session, &record);
+    if(rejoin && previous.dev_addr != dev_addr) {
+        fcnt_journal_remove(&session_journal, previous.dev_addr);
+        adr_engine_forget(&adr_engine, previous.dev_addr);
+    }
+    fcnt_journal_write_session(&session_journal, &record);
+    
+    // Queue for RX1 (JOIN_ACCEPT_DELAY1) with RX2 fallback
+    if(!tx_scheduler_enqueue_class_a(&tx_sched, response, JOIN_ACCEPT_LEN,
+                                     TX_PRIO_JOIN_ACCEPT, &last_rx_meta,
+                                     JOIN_ACCEPT_DELAY1_MS, TX_TAG_NONE)) {
+        log_warning("Join accept dropped: no airtime");
+    }
 }
@@ -2,6 +2,7 @@
 #define LORA_PROTOCOL_H
 
 #include <stdint.h>
+#include <stddef.h>
 
 // LoRaWAN Specification Versions
 #define LORAWAN_VERSION_1_0_4 0x04
@@ -77,6 +78,15 @@ typedef struct {
     uint8_t retries;
 } gateway_config_t;
 
+// Received Packet Metadata
+typedef struct {
+    uint32_t timestamp;          // RX end time (ms)
+    uint32_t freq_hz;            // Uplink channel frequency
+    uint8_t datarate;            // Uplink datarate index
+    int16_t rssi;                // dBm
+    int8_t snr;                  // dB
+} lora_rx_meta_t;
+
 // Function Prototypes
 void lora_configure(gateway_config_t config);
 uint8_t calculate_mic(const uint8_t *data, size_t len, const uint8_t *key);
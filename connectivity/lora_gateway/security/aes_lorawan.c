@@ -66,3 +66,75 @@ void calculate_mic(const uint8_t *data, size_t len, const uint8_t *key, uint8_t
     // Copy first 4 bytes as MIC
     memcpy(mic, mic_block, 4);
 }
+
+// Expand a key once so per-packet crypto skips the key schedule
+void lorawan_aes_expand_key(const uint8_t *key, aes128_schedule_t *sched) {
+    aes128_expand_key(key, sched->round_keys);
+}
+
+// AES-128 ECB encryption with a pre-expanded schedule
+void lorawan_aes_encrypt_sched(uint8_t *buffer, size_t len, const aes128_schedule_t *sched) {
+    for(size_t i = 0; i < len; i += 16) {
+        aes128_ecb_encrypt_expanded(buffer + i, sched->round_keys, buffer + i);
+    }
+}
+
+// CMAC subkey generation (RFC 4493): shift left, conditional XOR with Rb
+static void cmac_shift(const uint8_t *in, uint8_t *out) {
+    uint8_t carry = in[0] >> 7;
+    for(int i = 0; i < 15; i++) {
+        out[i] = (in[i] << 1) | (in[i + 1] >> 7);
+    }
+    out[15] = in[15] << 1;
+    if(carry) out[15] ^= 0x87;
+}
+
+// Calculate LoRaWAN MIC = aes128_cmac(NwkSKey, B0 | msg)[0..3]
+void lorawan_compute_mic_sched(const uint8_t *msg, size_t len, const aes128_schedule_t *sched,
+                               uint32_t dev_addr, uint32_t fcnt, uint8_t direction,
+                               uint8_t *mic) {
+    uint8_t b0[16] = {
+        0x49, 0x00, 0x00, 0x00, 0x00,
+        direction,
+        dev_addr & 0xFF, (dev_addr >> 8) & 0xFF,
+        (dev_addr >> 16) & 0xFF, (dev_addr >> 24) & 0xFF,
+        fcnt & 0xFF, (fcnt >> 8) & 0xFF,
+        (fcnt >> 16) & 0xFF, (fcnt >> 24) & 0xFF,
+        0x00, (uint8_t)len
+    };
+
+    // Subkeys K1/K2 from L = AES(K, 0^128)
+    uint8_t k1[16], k2[16];
+    uint8_t l[16] = {0};
+    aes128_ecb_encrypt_expanded(l, sched->round_keys, l);
+    cmac_shift(l, k1);
+    cmac_shift(k1, k2);
+
+    // First block is always B0, which is complete
+    uint8_t x[16];
+    aes128_ecb_encrypt_expanded(b0, sched->round_keys, x);
+
+    // msg is never empty (MHDR + FHDR at minimum)
+    size_t offset = 0;
+    while(len - offset > 16) {
+        for(int i = 0; i < 16; i++) x[i] ^= msg[offset + i];
+        aes128_ecb_encrypt_expanded(x, sched->round_keys, x);
+        offset += 16;
+    }
+
+    // Last block: complete -> XOR K1, partial -> pad 10* and XOR K2
+    size_t rem = len - offset;
+    uint8_t last[16] = {0};
+    memcpy(last, msg + offset, rem);
+    if(rem == 16) {
+        for(int i = 0; i < 16; i++) last[i] ^= k1[i];
+    } else {
+        last[rem] = 0x80;
+        for(int i = 0; i < 16; i++) last[i] ^= k2[i];
+    }
+
+    for(int i = 0; i < 16; i++) x[i] ^= last[i];
+    aes128_ecb_encrypt_expanded(x, sched->round_keys, x);
+
+    memcpy(mic, x, 4);
+}
@@ -0,0 +1,29 @@
+#ifndef AES_LORAWAN_H
+#define AES_LORAWAN_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Expanded AES-128 key schedule (11 round keys)
+typedef struct {
+    uint8_t round_keys[176];
+} aes128_schedule_t;
+
+// Crypto Backend (hardware-accelerated where available)
+void aes128_ecb_encrypt(const uint8_t *in, const uint8_t *key, uint8_t *out);
+void aes128_expand_key(const uint8_t *key, uint8_t *round_keys);
+void aes128_ecb_encrypt_expanded(const uint8_t *in, const uint8_t *round_keys, uint8_t *out);
+
+// LoRaWAN Crypto API
+void lorawan_aes_encrypt(uint8_t *buffer, size_t len, const uint8_t *key);
+void encrypt_payload(uint8_t *payload, size_t len, const uint8_t *key,
+                     uint32_t dev_addr, uint32_t counter, uint8_t direction);
+
+// Pre-expanded variants for cached session keys
+void lorawan_aes_expand_key(const uint8_t *key, aes128_schedule_t *sched);
+void lorawan_aes_encrypt_sched(uint8_t *buffer, size_t len, const aes128_schedule_t *sched);
+void lorawan_compute_mic_sched(const uint8_t *msg, size_t len, const aes128_schedule_t *sched,
+                               uint32_t dev_addr, uint32_t fcnt, uint8_t direction,
+                               uint8_t *mic);
+
+#endif // AES_LORAWAN_H
@@ -0,0 +1,540 @@
+#include "device_registry.h"
+#include "key_management.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SLOT_EMPTY 0xFFFFFFFFu
+
+#define LORAWAN_MIN_FRAME_LEN 12   // MHDR + FHDR(7) + MIC(4)
+
+// Fibonacci hashing spreads sequential DevAddrs across the table
+static inline uint32_t hash_addr(uint32_t addr) {
+    uint32_t h = addr * 0x9E3779B1u;
+    return h ^ (h >> 16);
+}
+
+static inline uint32_t hash_eui(uint64_t eui) {
+    eui ^= eui >> 33;
+    eui *= 0xFF51AFD7ED558CCDull;
+    eui ^= eui >> 33;
+    return (uint32_t)eui;
+}
+
+static inline uint64_t eui_to_u64(const uint8_t *eui) {
+    uint64_t v;
+    memcpy(&v, eui, sizeof(v));
+    return v;
+}
+
+static inline uint32_t read_le32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Seqlock writer side
+static inline void session_write_begin(device_session_t *s) {
+    atomic_fetch_add_explicit(&s->seq, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+static inline void session_write_end(device_session_t *s) {
+    atomic_fetch_add_explicit(&s->seq, 1, memory_order_release);
+}
+
+// False after a failed init: every API call is then rejected
+static inline bool registry_ready(const device_registry_t *reg) {
+    return reg->sessions != NULL;
+}
+
+static inline void mark_dirty(device_registry_t *reg, uint32_t slot) {
+    reg->dirty[slot / 64] |= 1ull << (slot % 64);
+}
+
+// Index Maintenance (writer only)
+static uint32_t addr_index_find(const device_registry_t *reg, uint32_t dev_addr) {
+    uint32_t pos = hash_addr(dev_addr) & reg->index_mask;
+    for(uint32_t probe = 0; probe <= reg->index_mask; probe++) {
+        uint32_t slot = atomic_load_explicit(&reg->addr_slots[pos], memory_order_acquire);
+        if(slot == SLOT_EMPTY) return SLOT_EMPTY;
+        if(reg->addr_keys[pos] == dev_addr && reg->sessions[slot].dev_addr == dev_addr) {
+            return pos;
+        }
+        pos = (pos + 1) & reg->index_mask;
+    }
+    return SLOT_EMPTY;
+}
+
+static uint32_t eui_index_find(const device_registry_t *reg, uint64_t eui) {
+    uint32_t pos = hash_eui(eui) & reg->index_mask;
+    for(uint32_t probe = 0; probe <= reg->index_mask; probe++) {
+        uint32_t slot = atomic_load_explicit(&reg->eui_slots[pos], memory_order_acquire);
+        if(slot == SLOT_EMPTY) return SLOT_EMPTY;
+        if(reg->eui_keys[pos] == eui) return pos;
+        pos = (pos + 1) & reg->index_mask;
+    }
+    return SLOT_EMPTY;
+}
+
+// Publish key before slot so readers that see the slot also see the key
+static void addr_index_insert(device_registry_t *reg, uint32_t dev_addr, uint32_t slot) {
+    uint32_t pos = hash_addr(dev_addr) & reg->index_mask;
+    for(uint32_t probe = 0; probe <= reg->index_mask; probe++) {
+        uint32_t cur = atomic_load_explicit(&reg->addr_slots[pos], memory_order_relaxed);
+        if(cur == SLOT_EMPTY) {
+            reg->addr_keys[pos] = dev_addr;
+            atomic_store_explicit(&reg->addr_slots[pos], slot, memory_order_release);
+            return;
+        }
+        pos = (pos + 1) & reg->index_mask;
+    }
+}
+
+static void eui_index_insert(device_registry_t *reg, uint64_t eui, uint32_t slot) {
+    uint32_t pos = hash_eui(eui) & reg->index_mask;
+    for(uint32_t probe = 0; probe <= reg->index_mask; probe++) {
+        uint32_t cur = atomic_load_explicit(&reg->eui_slots[pos], memory_order_relaxed);
+        if(cur == SLOT_EMPTY) {
+            reg->eui_keys[pos] = eui;
+            atomic_store_explicit(&reg->eui_slots[pos], slot, memory_order_release);
+            return;
+        }
+        pos = (pos + 1) & reg->index_mask;
+    }
+}
+
+// Index seqlock: readers retry a probe that overlapped a backward shift
+static inline void index_write_begin(device_registry_t *reg) {
+    atomic_fetch_add_explicit(&reg->index_seq, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+static inline void index_write_end(device_registry_t *reg) {
+    atomic_fetch_add_explicit(&reg->index_seq, 1, memory_order_release);
+}
+
+/**
+ * Backward-shift deletion: pull later members of the probe chain into the
+ * hole so no tombstones are left behind and misses stop at the first empty
+ * slot no matter how many rejoins the table has seen.
+ */
+static void addr_index_delete_at(device_registry_t *reg, uint32_t hole) {
+    uint32_t mask = reg->index_mask;
+    uint32_t pos = (hole + 1) & mask;
+
+    index_write_begin(reg);
+    while(1) {
+        uint32_t slot = atomic_load_explicit(&reg->addr_slots[pos], memory_order_relaxed);
+        if(slot == SLOT_EMPTY) break;
+
+        uint32_t home = hash_addr(reg->addr_keys[pos]) & mask;
+        if(((pos - home) & mask) >= ((pos - hole) & mask)) {
+            reg->addr_keys[hole] = reg->addr_keys[pos];
+            atomic_store_explicit(&reg->addr_slots[hole], slot, memory_order_release);
+            hole = pos;
+        }
+        pos = (pos + 1) & mask;
+    }
+    atomic_store_explicit(&reg->addr_slots[hole], SLOT_EMPTY, memory_order_release);
+    index_write_end(reg);
+}
+
+static void eui_index_delete_at(device_registry_t *reg, uint32_t hole) {
+    uint32_t mask = reg->index_mask;
+    uint32_t pos = (hole + 1) & mask;
+
+    index_write_begin(reg);
+    while(1) {
+        uint32_t slot = atomic_load_explicit(&reg->eui_slots[pos], memory_order_relaxed);
+        if(slot == SLOT_EMPTY) break;
+
+        uint32_t home = hash_eui(reg->eui_keys[pos]) & mask;
+        if(((pos - home) & mask) >= ((pos - hole) & mask)) {
+            reg->eui_keys[hole] = reg->eui_keys[pos];
+            atomic_store_explicit(&reg->eui_slots[hole], slot, memory_order_release);
+            hole = pos;
+        }
+        pos = (pos + 1) & mask;
+    }
+    atomic_store_explicit(&reg->eui_slots[hole], SLOT_EMPTY, memory_order_release);
+    index_write_end(reg);
+}
+
+// Only drop the mapping if it still belongs to slot; the DevAddr may have a new owner
+static void addr_index_remove(device_registry_t *reg, uint32_t dev_addr, uint32_t slot) {
+    uint32_t pos = addr_index_find(reg, dev_addr);
+    if(pos != SLOT_EMPTY &&
+       atomic_load_explicit(&reg->addr_slots[pos], memory_order_relaxed) == slot) {
+        addr_index_delete_at(reg, pos);
+    }
+}
+
+// A DevAddr reassigned to another device ends the previous holder's session
+static void addr_index_take_over(device_registry_t *reg, uint32_t dev_addr, uint32_t slot) {
+    uint32_t pos = addr_index_find(reg, dev_addr);
+    if(pos == SLOT_EMPTY) return;
+
+    uint32_t holder = atomic_load_explicit(&reg->addr_slots[pos], memory_order_relaxed);
+    addr_index_delete_at(reg, pos);
+    if(holder == slot) return;
+
+    device_session_t *s = &reg->sessions[holder];
+    session_write_begin(s);
+    s->active = 0;
+    session_write_end(s);
+    reg->dirty[holder / 64] &= ~(1ull << (holder % 64));
+}
+
+static uint32_t allocate_slot(device_registry_t *reg) {
+    if(reg->free_count > 0) return reg->free_list[--reg->free_count];
+    if(reg->count < reg->capacity) return reg->count++;
+    return SLOT_EMPTY;
+}
+
+// Install keys and identity into a slot and (re)index it
+static device_session_t *install_session(device_registry_t *reg, const device_record_t *rec) {
+    uint64_t eui = eui_to_u64(rec->dev_eui);
+    uint32_t eui_pos = eui_index_find(reg, eui);
+    uint32_t slot;
+
+    if(eui_pos != SLOT_EMPTY) {
+        // Rejoin: reuse the slot, drop the stale DevAddr mapping
+        slot = atomic_load_explicit(&reg->eui_slots[eui_pos], memory_order_relaxed);
+        addr_index_remove(reg, reg->sessions[slot].dev_addr, slot);
+    } else {
+        slot = allocate_slot(reg);
+        if(slot == SLOT_EMPTY) return NULL;
+    }
+
+    // A different device may still hold this DevAddr
+    addr_index_take_over(reg, rec->dev_addr, slot);
+
+    device_session_t *s = &reg->sessions[slot];
+    session_write_begin(s);
+    s->dev_addr = rec->dev_addr;
+    s->fcnt_up = rec->fcnt_up;
+    s->fcnt_down = rec->fcnt_down;
+    memcpy(s->dev_eui, rec->dev_eui, 8);
+    memcpy(s->app_eui, rec->app_eui, 8);
+    memcpy(s->nwk_skey, rec->nwk_skey, 16);
+    memcpy(s->app_skey, rec->app_skey, 16);
+    lorawan_aes_expand_key(rec->nwk_skey, &s->nwk_sched);
+    lorawan_aes_expand_key(rec->app_skey, &s->app_sched);
+    s->active = 1;
+    session_write_end(s);
+
+    addr_index_insert(reg, rec->dev_addr, slot);
+    if(eui_pos == SLOT_EMPTY) {
+        eui_index_insert(reg, eui, slot);
+    }
+    return s;
+}
+
+// Initialize Registry
+bool device_registry_init(device_registry_t *reg, uint32_t capacity) {
+    memset(reg, 0, sizeof(device_registry_t));
+    if(capacity == 0) return false;
+
+    // Index at <= 50% load keeps linear probes short
+    uint32_t index_size = 1;
+    while(index_size < capacity * 2) index_size <<= 1;
+
+    reg->capacity = capacity;
+    reg->index_mask = index_size - 1;
+    reg->sessions = aligned_alloc(64, (size_t)capacity * sizeof(device_session_t));
+    reg->free_list = malloc((size_t)capacity * sizeof(uint32_t));
+    reg->addr_keys = malloc((size_t)index_size * sizeof(uint32_t));
+    reg->addr_slots = malloc((size_t)index_size * sizeof(uint32_t));
+    reg->eui_keys = malloc((size_t)index_size * sizeof(uint64_t));
+    reg->eui_slots = malloc((size_t)index_size * sizeof(uint32_t));
+    reg->dirty = calloc((capacity + 63) / 64, sizeof(uint64_t));
+
+    if(!reg->sessions || !reg->free_list || !reg->addr_keys || !reg->addr_slots ||
+       !reg->eui_keys || !reg->eui_slots || !reg->dirty) {
+        device_registry_free(reg);
+        return false;
+    }
+
+    memset(reg->sessions, 0, (size_t)capacity * sizeof(device_session_t));
+    for(uint32_t i = 0; i < index_size; i++) {
+        atomic_init(&reg->addr_slots[i], SLOT_EMPTY);
+        atomic_init(&reg->eui_slots[i], SLOT_EMPTY);
+    }
+    return true;
+}
+
+void device_registry_free(device_registry_t *reg) {
+    free(reg->sessions);
+    free(reg->free_list);
+    free(reg->addr_keys);
+    free((void *)reg->addr_slots);
+    free(reg->eui_keys);
+    free((void *)reg->eui_slots);
+    free(reg->dirty);
+    memset(reg, 0, sizeof(device_registry_t));
+}
+
+/**
+ * Register an OTAA join: derive and expand session keys once
+ *
+ * @param reg Device registry
+ * @param app_eui Application EUI from the join request
+ * @param dev_eui Device EUI from the join request
+ * @param dev_addr DevAddr assigned in the join accept
+ * @param app_key Device root key
+ * @param dev_nonce DevNonce from the join request
+ * @return Cached session, or NULL if the registry is full
+ */
+device_session_t *device_registry_join(device_registry_t *reg, const uint8_t *app_eui,
+                                       const uint8_t *dev_eui, uint32_t dev_addr,
+                                       const uint8_t *app_key, const uint8_t *dev_nonce) {
+    if(!registry_ready(reg)) return NULL;
+
+    device_record_t rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.dev_addr = dev_addr;
+    memcpy(rec.dev_eui, dev_eui, 8);
+    memcpy(rec.app_eui, app_eui, 8);
+    derive_session_keys(app_key, dev_nonce, rec.nwk_skey, rec.app_skey);
+
+    device_session_t *s = install_session(reg, &rec);
+    if(s) mark_dirty(reg, (uint32_t)(s - reg->sessions));
+    return s;
+}
+
+// Reload a persisted session at boot (not marked dirty)
+bool device_registry_restore(device_registry_t *reg, const device_record_t *record) {
+    if(!registry_ready(reg)) return false;
+    return install_session(reg, record) != NULL;
+}
+
+bool device_registry_remove(device_registry_t *reg, const uint8_t *dev_eui) {
+    if(!registry_ready(reg)) return false;
+    uint32_t eui_pos = eui_index_find(reg, eui_to_u64(dev_eui));
+    if(eui_pos == SLOT_EMPTY) return false;
+
+    uint32_t slot = atomic_load_explicit(&reg->eui_slots[eui_pos], memory_order_relaxed);
+    device_session_t *s = &reg->sessions[slot];
+
+    addr_index_remove(reg, s->dev_addr, slot);
+    eui_index_delete_at(reg, eui_pos);
+
+    session_write_begin(s);
+    s->active = 0;
+    session_write_end(s);
+
+    reg->dirty[slot / 64] &= ~(1ull << (slot % 64));
+    reg->free_list[reg->free_count++] = slot;
+    return true;
+}
+
+static device_session_t *writable_session(device_registry_t *reg, uint32_t dev_addr) {
+    if(!registry_ready(reg)) return NULL;
+    uint32_t pos = addr_index_find(reg, dev_addr);
+    if(pos == SLOT_EMPTY) return NULL;
+    return &reg->sessions[atomic_load_explicit(&reg->addr_slots[pos], memory_order_relaxed)];
+}
+
+// Record the next expected uplink FCnt after a frame is accepted
+bool device_registry_set_fcnt_up(device_registry_t *reg, uint32_t dev_addr, uint32_t fcnt) {
+    device_session_t *s = writable_session(reg, dev_addr);
+    if(!s) return false;
+
+    session_write_begin(s);
+    s->fcnt_up = fcnt;
+    session_write_end(s);
+    mark_dirty(reg, (uint32_t)(s - reg->sessions));
+    return true;
+}
+
+bool device_registry_set_fcnt_down(device_registry_t *reg, uint32_t dev_addr, uint32_t fcnt) {
+    device_session_t *s = writable_session(reg, dev_addr);
+    if(!s) return false;
+
+    session_write_begin(s);
+    s->fcnt_down = fcnt;
+    session_write_end(s);
+    mark_dirty(reg, (uint32_t)(s - reg->sessions));
+    return true;
+}
+
+/**
+ * Persist all dirty sessions in batches of DEVICE_REGISTRY_PERSIST_BATCH
+ *
+ * @param reg Device registry
+ * @param persist Storage callback, invoked once per batch
+ * @param user Opaque pointer passed to persist
+ * @return Number of records written
+ */
+size_t device_registry_flush(device_registry_t *reg, device_persist_fn persist, void *user) {
+    device_record_t batch[DEVICE_REGISTRY_PERSIST_BATCH];
+    size_t batched = 0;
+    size_t written = 0;
+    uint32_t words = (reg->capacity + 63) / 64;
+    if(!registry_ready(reg)) return 0;
+
+    for(uint32_t w = 0; w < words; w++) {
+        uint64_t bits = reg->dirty[w];
+        reg->dirty[w] = 0;
+
+        while(bits) {
+            uint32_t slot = w * 64 + (uint32_t)__builtin_ctzll(bits);
+            bits &= bits - 1;
+
+            if(!device_registry_snapshot(&reg->sessions[slot], &batch[batched])) continue;
+            if(++batched == DEVICE_REGISTRY_PERSIST_BATCH) {
+                persist(batch, batched, user);
+                written += batched;
+                batched = 0;
+            }
+        }
+    }
+
+    if(batched > 0) {
+        persist(batch, batched, user);
+        written += batched;
+    }
+    return written;
+}
+
+// Lock-free lookup; callers must confirm identity via a seqlock snapshot
+const device_session_t *device_registry_find_addr(const device_registry_t *reg, uint32_t dev_addr) {
+    device_registry_t *r = (device_registry_t *)reg;
+    const device_session_t *found;
+    unsigned begin;
+    if(!registry_ready(reg)) return NULL;
+
+    do {
+        begin = atomic_load_explicit(&r->index_seq, memory_order_acquire);
+        if(begin & 1) continue;
+
+        found = NULL;
+        uint32_t pos = hash_addr(dev_addr) & reg->index_mask;
+        for(uint32_t probe = 0; probe <= reg->index_mask; probe++) {
+            uint32_t slot = atomic_load_explicit(&reg->addr_slots[pos], memory_order_acquire);
+            if(slot == SLOT_EMPTY) break;
+            if(reg->addr_keys[pos] == dev_addr) {
+                found = &reg->sessions[slot];
+                break;
+            }
+            pos = (pos + 1) & reg->index_mask;
+        }
+
+        atomic_thread_fence(memory_order_acquire);
+    } while((begin & 1) || begin != atomic_load_explicit(&r->index_seq, memory_order_relaxed));
+
+    return found;
+}
+
+const device_session_t *device_registry_find_eui(const device_registry_t *reg, const uint8_t *dev_eui) {
+    device_registry_t *r = (device_registry_t *)reg;
+    uint64_t eui = eui_to_u64(dev_eui);
+    const device_session_t *found;
+    unsigned begin;
+    if(!registry_ready(reg)) return NULL;
+
+    do {
+        begin = atomic_load_explicit(&r->index_seq, memory_order_acquire);
+        if(begin & 1) continue;
+
+        found = NULL;
+        uint32_t pos = hash_eui(eui) & reg->index_mask;
+        for(uint32_t probe = 0; probe <= reg->index_mask; probe++) {
+            uint32_t slot = atomic_load_explicit(&reg->eui_slots[pos], memory_order_acquire);
+            if(slot == SLOT_EMPTY) break;
+            if(reg->eui_keys[pos] == eui) {
+                found = &reg->sessions[slot];
+                break;
+            }
+            pos = (pos + 1) & reg->index_mask;
+        }
+
+        atomic_thread_fence(memory_order_acquire);
+    } while((begin & 1) || begin != atomic_load_explicit(&r->index_seq, memory_order_relaxed));
+
+    return found;
+}
+
+// Consistent copy of a session; retries while the writer is active
+bool device_registry_snapshot(const device_session_t *session, device_record_t *out) {
+    device_session_t *s = (device_session_t *)session;
+    unsigned begin, end;
+    uint8_t active;
+
+    do {
+        begin = atomic_load_explicit(&s->seq, memory_order_acquire);
+        if(begin & 1) continue;
+
+        active = s->active;
+        out->dev_addr = s->dev_addr;
+        out->fcnt_up = s->fcnt_up;
+        out->fcnt_down = s->fcnt_down;
+        memcpy(out->dev_eui, s->dev_eui, 8);
+        memcpy(out->app_eui, s->app_eui, 8);
+        memcpy(out->nwk_skey, s->nwk_skey, 16);
+        memcpy(out->app_skey, s->app_skey, 16);
+
+        atomic_thread_fence(memory_order_acquire);
+        end = atomic_load_explicit(&s->seq, memory_order_relaxed);
+    } while((begin & 1) || begin != end);
+
+    return active != 0;
+}
+
+bool device_registry_validate_credentials(const device_registry_t *reg,
+                                          const uint8_t *app_eui, const uint8_t *dev_eui) {
+    const device_session_t *s = device_registry_find_eui(reg, dev_eui);
+    device_record_t rec;
+    if(!s || !device_registry_snapshot(s, &rec)) return false;
+    return memcmp(rec.dev_eui, dev_eui, 8) == 0 && memcmp(rec.app_eui, app_eui, 8) == 0;
+}
+
+/**
+ * Verify an uplink MIC against the cached NwkSKey schedule
+ *
+ * @param reg Device registry
+ * @param packet PHYPayload (MHDR | FHDR | FPort | FRMPayload | MIC)
+ * @param len Packet length including MIC
+ * @param fcnt_out Reconstructed 32-bit FCnt on success (may be NULL)
+ * @return True if the device is known, the FCnt is fresh and the MIC matches
+ */
+bool device_registry_verify_packet(const device_registry_t *reg, const uint8_t *packet,
+                                   size_t len, uint32_t *fcnt_out) {
+    if(len < LORAWAN_MIN_FRAME_LEN) return false;
+
+    uint32_t dev_addr = read_le32(packet + 1);
+    uint16_t fcnt16 = (uint16_t)(packet[6] | (packet[7] << 8));
+
+    device_session_t *s = (device_session_t *)device_registry_find_addr(reg, dev_addr);
+    if(!s) return false;
+
+    uint8_t mic[4];
+    uint32_t fcnt;
+    unsigned begin, end;
+    bool known;
+
+    do {
+        begin = atomic_load_explicit(&s->seq, memory_order_acquire);
+        if(begin & 1) continue;
+
+        known = s->active && s->dev_addr == dev_addr;
+        uint32_t expected = s->fcnt_up;
+
+        // Rebuild the 32-bit counter from the 16 bits on air
+        fcnt = (expected & 0xFFFF0000u) | fcnt16;
+        if(fcnt < expected) fcnt += 0x10000u;
+
+        if(known) {
+            lorawan_compute_mic_sched(packet, len - 4, &s->nwk_sched, dev_addr, fcnt, 0, mic);
+        }
+
+        atomic_thread_fence(memory_order_acquire);
+        end = atomic_load_explicit(&s->seq, memory_order_relaxed);
+    } while((begin & 1) || begin != end);
+
+    if(!known || memcmp(mic, packet + len - 4, 4) != 0) {
+        return false;
+    }
+
+    if(fcnt_out) *fcnt_out = fcnt;
+    return true;
+}
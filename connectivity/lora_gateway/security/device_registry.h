@@ -0,0 +1,90 @@
+#ifndef DEVICE_REGISTRY_H
+#define DEVICE_REGISTRY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include "aes_lorawan.h"
+
+// Per-Device Session Cache
+// Keys are derived and expanded once per join; the uplink path then does a
+// single hash probe by DevAddr and runs the MIC with the cached schedule.
+// One writer (RX/join task), any number of lock-free readers (seqlock).
+
+#define DEVICE_REGISTRY_PERSIST_BATCH 32
+
+// Cached session (one cache line for the hot fields, schedules follow)
+typedef struct __attribute__((aligned(64))) {
+    atomic_uint seq;                // Odd while the writer is updating
+    uint32_t dev_addr;
+    uint32_t fcnt_up;               // Next expected uplink FCnt (32-bit)
+    uint32_t fcnt_down;
+    uint8_t dev_eui[8];
+    uint8_t app_eui[8];
+    uint8_t active;
+    aes128_schedule_t nwk_sched;    // Expanded NwkSKey (MIC)
+    aes128_schedule_t app_sched;    // Expanded AppSKey (FRMPayload)
+    uint8_t nwk_skey[16];
+    uint8_t app_skey[16];
+} device_session_t;
+
+// Snapshot handed to the persistence callback
+typedef struct {
+    uint32_t dev_addr;
+    uint8_t dev_eui[8];
+    uint8_t app_eui[8];
+    uint8_t nwk_skey[16];
+    uint8_t app_skey[16];
+    uint32_t fcnt_up;
+    uint32_t fcnt_down;
+} device_record_t;
+
+typedef void (*device_persist_fn)(const device_record_t *records, size_t count, void *user);
+
+typedef struct {
+    device_session_t *sessions;     // Dense session storage
+    uint32_t capacity;
+    uint32_t count;                 // Sessions ever allocated (free list below)
+    uint32_t *free_list;
+    uint32_t free_count;
+
+    // Open-addressed indexes: compact key arrays keep probes in few cache lines.
+    // Deletion shifts entries back (no tombstones); index_seq lets lock-free
+    // readers detect and retry a probe that raced with a shift.
+    atomic_uint index_seq;
+    uint32_t index_mask;
+    uint32_t *addr_keys;
+    _Atomic uint32_t *addr_slots;
+    uint64_t *eui_keys;
+    _Atomic uint32_t *eui_slots;
+
+    uint64_t *dirty;                // One bit per session awaiting persistence
+} device_registry_t;
+
+// Registry Lifecycle
+bool device_registry_init(device_registry_t *reg, uint32_t capacity);
+void device_registry_free(device_registry_t *reg);
+
+// Writer API (single writer)
+device_session_t *device_registry_join(device_registry_t *reg, const uint8_t *app_eui,
+                                       const uint8_t *dev_eui, uint32_t dev_addr,
+                                       const uint8_t *app_key, const uint8_t *dev_nonce);
+bool device_registry_restore(device_registry_t *reg, const device_record_t *record);
+bool device_registry_remove(device_registry_t *reg, const uint8_t *dev_eui);
+bool device_registry_set_fcnt_up(device_registry_t *reg, uint32_t dev_addr, uint32_t fcnt);
+bool device_registry_set_fcnt_down(device_registry_t *reg, uint32_t dev_addr, uint32_t fcnt);
+size_t device_registry_flush(device_registry_t *reg, device_persist_fn persist, void *user);
+
+// Reader API (lock-free)
+const device_session_t *device_registry_find_addr(const device_registry_t *reg, uint32_t dev_addr);
+const device_session_t *device_registry_find_eui(const device_registry_t *reg, const uint8_t *dev_eui);
+bool device_registry_snapshot(const device_session_t *session, device_record_t *out);
+
+// Device-aware replacements for key_management.h security utilities
+bool device_registry_validate_credentials(const device_registry_t *reg,
+                                          const uint8_t *app_eui, const uint8_t *dev_eui);
+bool device_registry_verify_packet(const device_registry_t *reg, const uint8_t *packet,
+                                   size_t len, uint32_t *fcnt_out);
+
+#endif // DEVICE_REGISTRY_H
@@ -0,0 +1,561 @@
+#include "fcnt_journal.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define JOURNAL_MAGIC 0x314A4346u        // "FCJ1"
+#define JOURNAL_HEADER_SIZE 16
+#define JOURNAL_NO_LOC 0xFFFFFFFFu
+
+// Record types (0xFF = erased flash, end of sector)
+#define REC_FCNT_UP 0x01
+#define REC_FCNT_DOWN 0x02
+#define REC_SESSION 0x10
+#define REC_REMOVE 0x20
+#define REC_ERASED 0xFF
+
+#define REC_HDR_SIZE 4
+#define REC_MAX_PAYLOAD (4 + sizeof(device_record_t))
+
+// Sector header
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t seq_inv;
+    uint32_t reserved;
+} sector_header_t;
+
+// Record header: crc covers type, len and payload
+typedef struct {
+    uint8_t type;
+    uint8_t len;
+    uint16_t crc;
+} record_header_t;
+
+typedef struct {
+    uint32_t dev_addr;
+    uint32_t fcnt;
+    uint32_t epoch;
+} counter_payload_t;
+
+typedef struct {
+    uint32_t dev_addr;
+    uint32_t epoch;
+} remove_payload_t;
+
+typedef struct {
+    uint32_t epoch;
+    device_record_t record;
+} session_payload_t;
+
+static uint16_t crc16_ccitt(const uint8_t *data, size_t len, uint16_t crc) {
+    for(size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for(int b = 0; b < 8; b++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static uint16_t record_crc(uint8_t type, uint8_t len, const uint8_t *payload) {
+    uint8_t hdr[2] = {type, len};
+    return crc16_ccitt(payload, len, crc16_ccitt(hdr, 2, 0xFFFF));
+}
+
+static inline uint32_t record_size(uint8_t len) {
+    return (REC_HDR_SIZE + len + 3u) & ~3u;
+}
+
+static inline uint32_t sector_base(const fcnt_journal_t *j, uint32_t sector) {
+    return sector * j->storage.sector_size;
+}
+
+static inline uint32_t free_sectors(const fcnt_journal_t *j) {
+    return j->storage.sector_count - j->used_sectors;
+}
+
+// False for a journal that was never opened or failed to open
+static inline bool journal_ready(const fcnt_journal_t *j) {
+    return j->entries != NULL;
+}
+
+// Device Table (open addressing, backward-shift deletion)
+static inline uint32_t entry_hash(uint32_t dev_addr) {
+    uint32_t h = dev_addr * 0x9E3779B1u;
+    return h ^ (h >> 16);
+}
+
+static journal_entry_t *entry_find(fcnt_journal_t *j, uint32_t dev_addr, bool create) {
+    uint32_t pos = entry_hash(dev_addr) & j->entry_mask;
+    for(uint32_t probe = 0; probe <= j->entry_mask; probe++) {
+        journal_entry_t *e = &j->entries[pos];
+        if(!e->used) {
+            if(!create) return NULL;
+            memset(e, 0, sizeof(journal_entry_t));
+            e->used = 1;
+            e->dev_addr = dev_addr;
+            e->session_loc = JOURNAL_NO_LOC;
+            return e;
+        }
+        if(e->dev_addr == dev_addr) return e;
+        pos = (pos + 1) & j->entry_mask;
+    }
+    return NULL;
+}
+
+static void entry_delete(fcnt_journal_t *j, journal_entry_t *e) {
+    uint32_t hole = (uint32_t)(e - j->entries);
+    uint32_t pos = (hole + 1) & j->entry_mask;
+
+    while(j->entries[pos].used) {
+        uint32_t home = entry_hash(j->entries[pos].dev_addr) & j->entry_mask;
+        // Move back if the hole lies between home and the current position
+        if(((pos - home) & j->entry_mask) >= ((pos - hole) & j->entry_mask)) {
+            j->entries[hole] = j->entries[pos];
+            hole = pos;
+        }
+        pos = (pos + 1) & j->entry_mask;
+    }
+    j->entries[hole].used = 0;
+}
+
+// Sector Management
+static bool write_sector_header(fcnt_journal_t *j, uint32_t sector, uint32_t seq) {
+    sector_header_t hdr = {
+        .magic = JOURNAL_MAGIC,
+        .seq = seq,
+        .seq_inv = ~seq,
+        .reserved = 0xFFFFFFFFu
+    };
+    return j->storage.program(j->storage.ctx, sector_base(j, sector), &hdr, sizeof(hdr)) == 0;
+}
+
+static bool open_sector(fcnt_journal_t *j, uint32_t sector) {
+    if(j->storage.erase_sector(j->storage.ctx, sector) != 0) return false;
+    j->sectors_erased++;
+
+    uint32_t seq = j->next_seq++;
+    if(!write_sector_header(j, sector, seq)) return false;
+
+    j->sector_seq[sector] = seq;
+    j->head = sector;
+    j->head_offset = JOURNAL_HEADER_SIZE;
+    j->used_sectors++;
+    return true;
+}
+
+/**
+ * Program buffered records in one write
+ * On failure the records stay buffered at the same offset: reprogramming the
+ * same bytes over a partial write is safe on NOR, so the next flush retries.
+ *
+ * @param j Journal
+ * @return True if nothing is left buffered
+ */
+bool fcnt_journal_flush(fcnt_journal_t *j) {
+    if(!journal_ready(j)) return false;
+    if(j->buffer_len == 0) return true;
+
+    int err = j->storage.program(j->storage.ctx, sector_base(j, j->head) + j->head_offset,
+                                 j->buffer, j->buffer_len);
+    if(err != 0) return false;
+
+    j->head_offset += j->buffer_len;
+    j->buffer_len = 0;
+    j->flush_gen++;
+    return true;
+}
+
+// Never erases live data; only compaction may dip into the reserve
+static bool advance_head(fcnt_journal_t *j, bool compacting) {
+    if(!fcnt_journal_flush(j)) return false;
+
+    if(!compacting && free_sectors(j) <= JOURNAL_MIN_FREE_SECTORS) return false;
+
+    uint32_t next = (j->head + 1) % j->storage.sector_count;
+    if(j->sector_seq[next] != 0) return false;   // Ring full
+    return open_sector(j, next);
+}
+
+static bool append_record(fcnt_journal_t *j, uint8_t type, const void *payload, uint8_t len,
+                          bool compacting, uint32_t *loc_out) {
+    uint32_t size = record_size(len);
+
+    if(j->head_offset + j->buffer_len + size > j->storage.sector_size) {
+        if(!advance_head(j, compacting)) return false;
+    }
+    if(j->buffer_len + size > JOURNAL_WRITE_BUFFER) {
+        if(!fcnt_journal_flush(j)) return false;
+    }
+
+    uint8_t *dst = j->buffer + j->buffer_len;
+    record_header_t hdr = {
+        .type = type,
+        .len = len,
+        .crc = record_crc(type, len, payload)
+    };
+    memset(dst, 0xFF, size);
+    memcpy(dst, &hdr, REC_HDR_SIZE);
+    memcpy(dst + REC_HDR_SIZE, payload, len);
+
+    if(loc_out) *loc_out = sector_base(j, j->head) + j->head_offset + j->buffer_len;
+    j->buffer_len += size;
+    j->records_written++;
+    return true;
+}
+
+// Read and validate one record; returns false on erased space or a torn write
+static bool read_record(fcnt_journal_t *j, uint32_t loc, record_header_t *hdr, uint8_t *payload) {
+    if(j->storage.read(j->storage.ctx, loc, hdr, REC_HDR_SIZE) != 0) return false;
+    if(hdr->type == REC_ERASED || hdr->len > REC_MAX_PAYLOAD) return false;
+    if(j->storage.read(j->storage.ctx, loc + REC_HDR_SIZE, payload, hdr->len) != 0) return false;
+    return hdr->crc == record_crc(hdr->type, hdr->len, payload);
+}
+
+// Replay
+static void note_epoch(fcnt_journal_t *j, uint32_t epoch) {
+    if(epoch >= j->next_epoch) j->next_epoch = epoch + 1;
+}
+
+// Order-independent: highest epoch wins, counters take the max within an epoch
+static void replay_record(fcnt_journal_t *j, const record_header_t *hdr,
+                          const uint8_t *payload, uint32_t loc) {
+    switch(hdr->type) {
+        case REC_FCNT_UP:
+        case REC_FCNT_DOWN: {
+            counter_payload_t c;
+            memcpy(&c, payload, sizeof(c));
+            journal_entry_t *e = entry_find(j, c.dev_addr, true);
+            if(!e || c.epoch < e->epoch) break;
+
+            if(c.epoch > e->epoch) {
+                e->epoch = c.epoch;
+                e->removed = 0;
+                e->fcnt[0] = e->fcnt[1] = 0;
+                e->session_loc = JOURNAL_NO_LOC;
+            }
+            uint8_t dir = hdr->type == REC_FCNT_UP ? JOURNAL_DIR_UP : JOURNAL_DIR_DOWN;
+            if(c.fcnt > e->fcnt[dir]) e->fcnt[dir] = c.fcnt;
+            note_epoch(j, c.epoch);
+            break;
+        }
+        case REC_SESSION: {
+            session_payload_t s;
+            memcpy(&s, payload, sizeof(s));
+            journal_entry_t *e = entry_find(j, s.record.dev_addr, true);
+            if(!e || s.epoch < e->epoch) break;
+
+            if(s.epoch > e->epoch) {
+                e->epoch = s.epoch;
+                e->removed = 0;
+                e->fcnt[JOURNAL_DIR_UP] = s.record.fcnt_up;
+                e->fcnt[JOURNAL_DIR_DOWN] = s.record.fcnt_down;
+            }
+            e->session_loc = loc;
+            note_epoch(j, s.epoch);
+            break;
+        }
+        case REC_REMOVE: {
+            remove_payload_t r;
+            memcpy(&r, payload, sizeof(r));
+            journal_entry_t *e = entry_find(j, r.dev_addr, true);
+            if(!e || r.epoch < e->epoch) break;
+
+            e->epoch = r.epoch;
+            e->removed = 1;
+            e->session_loc = JOURNAL_NO_LOC;
+            note_epoch(j, r.epoch);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+// Compaction: copy still-live records out of the tail sector, then erase it
+static bool record_is_live(fcnt_journal_t *j, const record_header_t *hdr,
+                           const uint8_t *payload, uint32_t loc) {
+    if(hdr->type == REC_FCNT_UP || hdr->type == REC_FCNT_DOWN) {
+        counter_payload_t c;
+        memcpy(&c, payload, sizeof(c));
+        journal_entry_t *e = entry_find(j, c.dev_addr, false);
+        uint8_t dir = hdr->type == REC_FCNT_UP ? JOURNAL_DIR_UP : JOURNAL_DIR_DOWN;
+        return e && !e->removed && e->epoch == c.epoch && e->fcnt[dir] == c.fcnt;
+    }
+
+    if(hdr->type == REC_SESSION) {
+        session_payload_t s;
+        memcpy(&s, payload, sizeof(s));
+        journal_entry_t *e = entry_find(j, s.record.dev_addr, false);
+        return e && e->session_loc == loc;
+    }
+
+    if(hdr->type == REC_REMOVE) {
+        // Everything it shadowed is older and already gone; drop the tombstone
+        remove_payload_t r;
+        memcpy(&r, payload, sizeof(r));
+        journal_entry_t *e = entry_find(j, r.dev_addr, false);
+        if(e && e->removed && e->epoch == r.epoch) entry_delete(j, e);
+    }
+    return false;
+}
+
+static bool compact_oldest(fcnt_journal_t *j) {
+    if(j->used_sectors <= 1) return false;
+
+    uint32_t victim = j->tail;
+    uint8_t payload[REC_MAX_PAYLOAD];
+    record_header_t hdr;
+    uint32_t offset = JOURNAL_HEADER_SIZE;
+
+    while(offset + REC_HDR_SIZE <= j->storage.sector_size) {
+        uint32_t loc = sector_base(j, victim) + offset;
+        if(!read_record(j, loc, &hdr, payload)) break;
+        offset += record_size(hdr.len);
+
+        if(!record_is_live(j, &hdr, payload, loc)) continue;
+
+        uint32_t new_loc;
+        if(!append_record(j, hdr.type, payload, hdr.len, true, &new_loc)) return false;
+        if(hdr.type == REC_SESSION) {
+            session_payload_t s;
+            memcpy(&s, payload, sizeof(s));
+            entry_find(j, s.record.dev_addr, false)->session_loc = new_loc;
+        }
+    }
+
+    // Copies must be durable before the originals disappear
+    if(!fcnt_journal_flush(j)) return false;
+    if(j->storage.erase_sector(j->storage.ctx, victim) != 0) return false;
+
+    j->sectors_erased++;
+    j->sector_seq[victim] = 0;
+    j->used_sectors--;
+    j->tail = (victim + 1) % j->storage.sector_count;
+    return true;
+}
+
+static bool scan_sector(fcnt_journal_t *j, uint32_t sector, uint32_t *end_offset) {
+    uint8_t payload[REC_MAX_PAYLOAD];
+    record_header_t hdr;
+    uint32_t offset = JOURNAL_HEADER_SIZE;
+
+    while(offset + REC_HDR_SIZE <= j->storage.sector_size) {
+        uint32_t loc = sector_base(j, sector) + offset;
+        if(!read_record(j, loc, &hdr, payload)) {
+            // Erased space ends the sector cleanly; anything else is a torn write
+            *end_offset = offset;
+            return hdr.type == REC_ERASED;
+        }
+        replay_record(j, &hdr, payload, loc);
+        offset += record_size(hdr.len);
+    }
+    *end_offset = offset;
+    return true;
+}
+
+/**
+ * Open the journal and replay it into the in-memory device table
+ *
+ * @param j Journal state
+ * @param storage Backend (flash partition or host file)
+ * @param max_devices Expected number of devices (table sizing)
+ * @return True if the journal is ready for appends
+ */
+bool fcnt_journal_open(fcnt_journal_t *j, const journal_storage_t *storage, uint32_t max_devices) {
+    memset(j, 0, sizeof(fcnt_journal_t));
+    memcpy(&j->storage, storage, sizeof(journal_storage_t));
+    if(storage->sector_count < JOURNAL_MIN_FREE_SECTORS + JOURNAL_HEADROOM_SECTORS + 1) {
+        return false;
+    }
+
+    uint32_t table_size = 1;
+    while(table_size < max_devices * 2) table_size <<= 1;
+
+    j->entries = calloc(table_size, sizeof(journal_entry_t));
+    j->sector_seq = calloc(storage->sector_count, sizeof(uint32_t));
+    if(!j->entries || !j->sector_seq) {
+        fcnt_journal_close(j);
+        return false;
+    }
+    j->entry_mask = table_size - 1;
+    j->next_seq = 1;
+    j->next_epoch = 1;
+    j->flush_gen = 1;
+
+    // Locate valid sectors and the ring's tail
+    uint32_t min_seq = 0xFFFFFFFFu;
+    for(uint32_t s = 0; s < storage->sector_count; s++) {
+        sector_header_t hdr;
+        if(storage->read(storage->ctx, sector_base(j, s), &hdr, sizeof(hdr)) != 0) continue;
+        if(hdr.magic != JOURNAL_MAGIC || hdr.seq_inv != ~hdr.seq || hdr.seq == 0) continue;
+
+        j->sector_seq[s] = hdr.seq;
+        j->used_sectors++;
+        if(hdr.seq < min_seq) {
+            min_seq = hdr.seq;
+            j->tail = s;
+        }
+        if(hdr.seq >= j->next_seq) {
+            j->next_seq = hdr.seq + 1;
+            j->head = s;
+        }
+    }
+
+    if(j->used_sectors == 0) {
+        j->tail = 0;
+        if(open_sector(j, 0)) return true;
+        fcnt_journal_close(j);
+        return false;
+    }
+
+    // Replay oldest to newest; the ring is contiguous from tail to head
+    bool head_clean = true;
+    for(uint32_t i = 0, s = j->tail; i < storage->sector_count; i++) {
+        if(j->sector_seq[s] != 0) {
+            uint32_t end;
+            bool clean = scan_sector(j, s, &end);
+            if(s == j->head) {
+                j->head_offset = end;
+                head_clean = clean;
+            }
+        }
+        if(s == j->head) break;
+        s = (s + 1) % storage->sector_count;
+    }
+
+    // Never program over a torn record; continue in a fresh sector (may use
+    // the reserve, the next fcnt_journal_maintain() restores it)
+    if(!head_clean) {
+        j->head_offset = storage->sector_size;
+        if(!advance_head(j, true)) {
+            fcnt_journal_close(j);
+            return false;
+        }
+    }
+    return true;
+}
+
+void fcnt_journal_close(fcnt_journal_t *j) {
+    if(j->entries && j->sector_seq) {
+        fcnt_journal_flush(j);
+    }
+    free(j->entries);
+    free(j->sector_seq);
+    j->entries = NULL;
+    j->sector_seq = NULL;
+}
+
+/**
+ * Record a frame counter; only every JOURNAL_FCNT_STRIDE-th value is written
+ *
+ * @param j Journal state
+ * @param dev_addr Device address
+ * @param dir JOURNAL_DIR_UP or JOURNAL_DIR_DOWN
+ * @param fcnt Current counter value
+ * @return False on storage failure
+ */
+bool fcnt_journal_note_fcnt(fcnt_journal_t *j, uint32_t dev_addr, uint8_t dir, uint32_t fcnt) {
+    if(!journal_ready(j)) return false;
+    journal_entry_t *e = entry_find(j, dev_addr, true);
+    if(!e) return false;
+
+    if(fcnt < e->fcnt[dir] + JOURNAL_FCNT_STRIDE) {
+        j->records_coalesced++;
+        return true;
+    }
+
+    // At most one unflushed record per device keeps the recovery window at 2 strides
+    if(e->pending_gen == j->flush_gen && !fcnt_journal_flush(j)) {
+        return false;
+    }
+
+    counter_payload_t c = {
+        .dev_addr = dev_addr,
+        .fcnt = fcnt,
+        .epoch = e->epoch
+    };
+    uint8_t type = dir == JOURNAL_DIR_UP ? REC_FCNT_UP : REC_FCNT_DOWN;
+    if(!append_record(j, type, &c, sizeof(c), false, NULL)) return false;
+
+    e->fcnt[dir] = fcnt;
+    e->pending_gen = j->flush_gen;
+    return true;
+}
+
+// Queue a (re)joined session record; durable after the next flush or maintain
+bool fcnt_journal_write_session(fcnt_journal_t *j, const device_record_t *record) {
+    if(!journal_ready(j)) return false;
+    journal_entry_t *e = entry_find(j, record->dev_addr, true);
+    if(!e) return false;
+
+    session_payload_t s;
+    s.epoch = j->next_epoch++;
+    memcpy(&s.record, record, sizeof(device_record_t));
+
+    uint32_t loc;
+    if(!append_record(j, REC_SESSION, &s, sizeof(s), false, &loc)) return false;
+
+    e->epoch = s.epoch;
+    e->removed = 0;
+    e->fcnt[JOURNAL_DIR_UP] = record->fcnt_up;
+    e->fcnt[JOURNAL_DIR_DOWN] = record->fcnt_down;
+    e->session_loc = loc;
+    e->pending_gen = j->flush_gen;
+    return true;
+}
+
+bool fcnt_journal_remove(fcnt_journal_t *j, uint32_t dev_addr) {
+    if(!journal_ready(j)) return false;
+    journal_entry_t *e = entry_find(j, dev_addr, false);
+    if(!e || e->removed) return false;
+
+    remove_payload_t r = {
+        .dev_addr = dev_addr,
+        .epoch = j->next_epoch++
+    };
+    if(!append_record(j, REC_REMOVE, &r, sizeof(r), false, NULL)) return false;
+
+    e->epoch = r.epoch;
+    e->removed = 1;
+    e->session_loc = JOURNAL_NO_LOC;
+    return true;
+}
+
+// Idle-time housekeeping: flush, then compact one sector once appends have
+// eaten into the headroom (the only place the journal erases)
+bool fcnt_journal_maintain(fcnt_journal_t *j) {
+    if(!fcnt_journal_flush(j)) return false;
+    if(free_sectors(j) > JOURNAL_MIN_FREE_SECTORS + JOURNAL_HEADROOM_SECTORS) return true;
+    return compact_oldest(j);
+}
+
+/**
+ * Load every live session into the registry
+ *
+ * Downlink counters jump ahead by JOURNAL_FCNT_WINDOW so no FCnt is reused.
+ * Uplink counters restore the last persisted value: they only gate replay
+ * and jumping ahead would reject the device's next frames.
+ *
+ * @return Number of sessions restored
+ */
+size_t fcnt_journal_restore(fcnt_journal_t *j, device_registry_t *reg) {
+    uint8_t payload[REC_MAX_PAYLOAD];
+    record_header_t hdr;
+    size_t restored = 0;
+    if(!journal_ready(j)) return 0;
+
+    for(uint32_t i = 0; i <= j->entry_mask; i++) {
+        journal_entry_t *e = &j->entries[i];
+        if(!e->used || e->removed || e->session_loc == JOURNAL_NO_LOC) continue;
+        if(!read_record(j, e->session_loc, &hdr, payload) || hdr.type != REC_SESSION) continue;
+
+        session_payload_t s;
+        memcpy(&s, payload, sizeof(s));
+        s.record.fcnt_up = e->fcnt[JOURNAL_DIR_UP];
+        s.record.fcnt_down = e->fcnt[JOURNAL_DIR_DOWN] + JOURNAL_FCNT_WINDOW;
+
+        if(device_registry_restore(reg, &s.record)) restored++;
+    }
+    return restored;
+}
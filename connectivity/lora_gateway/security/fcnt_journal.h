@@ -0,0 +1,92 @@
+#ifndef FCNT_JOURNAL_H
+#define FCNT_JOURNAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "device_registry.h"
+
+// Frame-Counter / Session Journal
+// Append-only log spread over a ring of erase sectors. Counters are written
+// only every JOURNAL_FCNT_STRIDE frames and buffered into page-sized
+// programs; on recovery the downlink counter jumps ahead by
+// JOURNAL_FCNT_WINDOW so a lost tail can never cause FCnt reuse (the uplink
+// counter restores its last persisted value). Appends never erase: the
+// oldest sector is compacted (live records copied forward, sector erased)
+// only from fcnt_journal_maintain(), which also flushes buffered records.
+
+#define JOURNAL_FCNT_STRIDE 32
+#define JOURNAL_FCNT_WINDOW (2 * JOURNAL_FCNT_STRIDE)
+#define JOURNAL_WRITE_BUFFER 256
+#define JOURNAL_MIN_FREE_SECTORS 2      // Held back for compaction copies
+#define JOURNAL_HEADROOM_SECTORS 2      // Appends allowed between maintain calls
+
+// Counter direction
+#define JOURNAL_DIR_UP 0
+#define JOURNAL_DIR_DOWN 1
+
+// Storage Backend (NOR semantics: erase to 0xFF, program 1 -> 0 only)
+typedef struct {
+    int (*read)(void *ctx, uint32_t offset, void *buf, size_t len);
+    int (*program)(void *ctx, uint32_t offset, const void *buf, size_t len);
+    int (*erase_sector)(void *ctx, uint32_t sector);
+    uint32_t sector_size;
+    uint32_t sector_count;
+    void *ctx;
+} journal_storage_t;
+
+// Per-device replay state
+typedef struct {
+    uint32_t dev_addr;
+    uint32_t epoch;             // Session generation (journal-wide counter)
+    uint32_t fcnt[2];           // Highest persisted counter per direction
+    uint32_t session_loc;       // Storage offset of the live session record
+    uint32_t pending_gen;       // == journal flush_gen while buffered
+    uint8_t used;
+    uint8_t removed;
+} journal_entry_t;
+
+typedef struct {
+    journal_storage_t storage;
+
+    journal_entry_t *entries;
+    uint32_t entry_mask;
+
+    uint32_t *sector_seq;       // Sequence per sector, 0 = free
+    uint32_t tail;              // Oldest live sector
+    uint32_t head;              // Sector being appended to
+    uint32_t head_offset;       // Next program offset within head
+    uint32_t next_seq;
+    uint32_t next_epoch;
+    uint32_t used_sectors;
+
+    uint8_t buffer[JOURNAL_WRITE_BUFFER];
+    uint32_t buffer_len;
+    uint32_t flush_gen;
+
+    uint32_t records_written;
+    uint32_t records_coalesced;
+    uint32_t sectors_erased;
+} fcnt_journal_t;
+
+// Journal Lifecycle
+bool fcnt_journal_open(fcnt_journal_t *j, const journal_storage_t *storage, uint32_t max_devices);
+void fcnt_journal_close(fcnt_journal_t *j);
+
+// Write Path
+bool fcnt_journal_note_fcnt(fcnt_journal_t *j, uint32_t dev_addr, uint8_t dir, uint32_t fcnt);
+bool fcnt_journal_write_session(fcnt_journal_t *j, const device_record_t *record);
+bool fcnt_journal_remove(fcnt_journal_t *j, uint32_t dev_addr);
+bool fcnt_journal_flush(fcnt_journal_t *j);
+bool fcnt_journal_maintain(fcnt_journal_t *j);
+
+// Recovery: load sessions into the registry with counters jumped ahead
+size_t fcnt_journal_restore(fcnt_journal_t *j, device_registry_t *reg);
+
+// Backends
+bool journal_flash_storage_init(journal_storage_t *storage, const char *partition_label);
+bool journal_file_storage_init(journal_storage_t *storage, const char *path,
+                               uint32_t sector_size, uint32_t sector_count);
+void journal_file_storage_close(journal_storage_t *storage);
+
+#endif // FCNT_JOURNAL_H
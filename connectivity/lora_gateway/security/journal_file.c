@@ -0,0 +1,99 @@
+#include "fcnt_journal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Host File Backend
+// Emulates NOR flash in a regular file so journal recovery can be exercised
+// off-target: erase fills a sector with 0xFF, program can only clear bits.
+
+typedef struct {
+    FILE *fp;
+    uint32_t sector_size;
+    uint32_t size;
+} journal_file_t;
+
+static int file_read(void *ctx, uint32_t offset, void *buf, size_t len) {
+    journal_file_t *f = (journal_file_t *)ctx;
+    if(offset + len > f->size) return -1;
+    if(fseek(f->fp, offset, SEEK_SET) != 0) return -1;
+    return fread(buf, 1, len, f->fp) == len ? 0 : -1;
+}
+
+static int file_program(void *ctx, uint32_t offset, const void *buf, size_t len) {
+    journal_file_t *f = (journal_file_t *)ctx;
+    uint8_t chunk[256];
+    const uint8_t *src = (const uint8_t *)buf;
+
+    while(len > 0) {
+        size_t n = len < sizeof(chunk) ? len : sizeof(chunk);
+        if(file_read(ctx, offset, chunk, n) != 0) return -1;
+        for(size_t i = 0; i < n; i++) chunk[i] &= src[i];
+
+        if(fseek(f->fp, offset, SEEK_SET) != 0) return -1;
+        if(fwrite(chunk, 1, n, f->fp) != n) return -1;
+        offset += n;
+        src += n;
+        len -= n;
+    }
+    return fflush(f->fp) == 0 ? 0 : -1;
+}
+
+static int file_erase_sector(void *ctx, uint32_t sector) {
+    journal_file_t *f = (journal_file_t *)ctx;
+    uint8_t blank[256];
+    memset(blank, 0xFF, sizeof(blank));
+
+    if(fseek(f->fp, (long)sector * f->sector_size, SEEK_SET) != 0) return -1;
+    for(uint32_t done = 0; done < f->sector_size; done += sizeof(blank)) {
+        size_t n = f->sector_size - done < sizeof(blank) ? f->sector_size - done : sizeof(blank);
+        if(fwrite(blank, 1, n, f->fp) != n) return -1;
+    }
+    return fflush(f->fp) == 0 ? 0 : -1;
+}
+
+// Open (or create erased) a journal image file
+bool journal_file_storage_init(journal_storage_t *storage, const char *path,
+                               uint32_t sector_size, uint32_t sector_count) {
+    journal_file_t *f = calloc(1, sizeof(journal_file_t));
+    if(!f) return false;
+
+    f->sector_size = sector_size;
+    f->size = sector_size * sector_count;
+    f->fp = fopen(path, "r+b");
+
+    bool fresh = false;
+    if(!f->fp) {
+        f->fp = fopen(path, "w+b");
+        fresh = true;
+    }
+    if(!f->fp) {
+        free(f);
+        return false;
+    }
+
+    storage->read = file_read;
+    storage->program = file_program;
+    storage->erase_sector = file_erase_sector;
+    storage->sector_size = sector_size;
+    storage->sector_count = sector_count;
+    storage->ctx = f;
+
+    if(fresh) {
+        for(uint32_t s = 0; s < sector_count; s++) {
+            if(file_erase_sector(f, s) != 0) {
+                journal_file_storage_close(storage);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void journal_file_storage_close(journal_storage_t *storage) {
+    journal_file_t *f = (journal_file_t *)storage->ctx;
+    if(!f) return;
+    fclose(f->fp);
+    free(f);
+    storage->ctx = NULL;
+}
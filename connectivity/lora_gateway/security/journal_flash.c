@@ -0,0 +1,39 @@
+#include "fcnt_journal.h"
+#include "esp_partition.h"
+#include "esp_log.h"
+
+static const char *TAG = "FcntJournal";
+
+// Flash Partition Backend (ESP-IDF data partition, 4 KiB erase sectors)
+
+static int flash_read(void *ctx, uint32_t offset, void *buf, size_t len) {
+    return esp_partition_read((const esp_partition_t *)ctx, offset, buf, len) == ESP_OK ? 0 : -1;
+}
+
+static int flash_program(void *ctx, uint32_t offset, const void *buf, size_t len) {
+    return esp_partition_write((const esp_partition_t *)ctx, offset, buf, len) == ESP_OK ? 0 : -1;
+}
+
+static int flash_erase_sector(void *ctx, uint32_t sector) {
+    const esp_partition_t *part = (const esp_partition_t *)ctx;
+    esp_err_t err = esp_partition_erase_range(part, sector * SPI_FLASH_SEC_SIZE, SPI_FLASH_SEC_SIZE);
+    return err == ESP_OK ? 0 : -1;
+}
+
+// Bind the journal to a data partition by label
+bool journal_flash_storage_init(journal_storage_t *storage, const char *partition_label) {
+    const esp_partition_t *part = esp_partition_find_first(
+        ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, partition_label);
+    if(!part) {
+        ESP_LOGE(TAG, "Partition '%s' not found", partition_label);
+        return false;
+    }
+
+    storage->read = flash_read;
+    storage->program = flash_program;
+    storage->erase_sector = flash_erase_sector;
+    storage->sector_size = SPI_FLASH_SEC_SIZE;
+    storage->sector_count = part->size / SPI_FLASH_SEC_SIZE;
+    storage->ctx = (void *)part;
+    return true;
+}
@@ -0,0 +1,96 @@
+// Host tests for the ADR engine's LinkADRReq encoding
+//   cc -I.. test_adr_engine.c ../adr_engine.c ../tx_scheduler.c -lm -o test_adr_engine
+
+#include "adr_engine.h"
+#include <stdio.h>
+#include <string.h>
+
+#define DEV_ADDR 0x26010001u
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if(!(cond)) { \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while(0)
+
+// Strong link: a full history makes the engine raise the datarate
+static adr_device_t *converge(adr_engine_t *engine) {
+    adr_device_t *dev = NULL;
+    for(int i = 0; i < ADR_HISTORY && !dev; i++) {
+        dev = adr_engine_on_uplink(engine, DEV_ADDR, 0, 10, -80, true);
+    }
+    return dev;
+}
+
+static void init_engine(adr_engine_t *engine, region_t region) {
+    adr_config_t config = { .region = region, .nb_trans = 1 };
+    CHECK(adr_engine_init(engine, &config, 16));
+}
+
+// EU868: one command, channels 0-2 only
+static void test_eu868_mask(void) {
+    adr_engine_t engine;
+    uint8_t out[ADR_LINK_ADR_REQ_MAX_LEN];
+
+    init_engine(&engine, EU868);
+    adr_device_t *dev = converge(&engine);
+    CHECK(dev != NULL);
+    if(!dev) return;
+
+    CHECK(adr_build_link_adr_req(&engine, dev, out) == ADR_LINK_ADR_REQ_LEN);
+    CHECK(out[0] == ADR_CID_LINK_ADR_REQ);
+    CHECK((out[1] >> 4) == dev->target_dr && dev->target_dr > 0);
+    CHECK(out[2] == 0x07 && out[3] == 0x00);
+    CHECK(out[4] == 0x01);
+    adr_engine_free(&engine);
+}
+
+// US915 / AU915: ChMaskCntl 7 turns channels 8-63 off before sub-band 1 is enabled
+static void test_us915_block(region_t region) {
+    adr_engine_t engine;
+    uint8_t out[ADR_LINK_ADR_REQ_MAX_LEN];
+
+    init_engine(&engine, region);
+    adr_device_t *dev = converge(&engine);
+    CHECK(dev != NULL);
+    if(!dev) return;
+
+    CHECK(adr_build_link_adr_req(&engine, dev, out) == 2 * ADR_LINK_ADR_REQ_LEN);
+    const uint8_t *first = out;
+    const uint8_t *second = out + ADR_LINK_ADR_REQ_LEN;
+
+    CHECK(first[0] == ADR_CID_LINK_ADR_REQ && second[0] == ADR_CID_LINK_ADR_REQ);
+    CHECK((first[4] >> 4) == 7);
+    CHECK(first[2] == 0x00 && first[3] == 0x00);
+    CHECK((second[4] >> 4) == 0);
+    CHECK(second[2] == 0xFF && second[3] == 0x00);
+
+    // DR, TXPower and NbTrans come from the last command; keep them identical
+    CHECK(first[1] == second[1]);
+    CHECK((first[4] & 0x0F) == 1 && (second[4] & 0x0F) == 1);
+
+    // One LinkADRAns per command: the first commits, the second is ignored
+    uint8_t target = dev->target_dr;
+    adr_engine_on_link_adr_ans(&engine, DEV_ADDR, ADR_ANS_CHMASK_ACK | ADR_ANS_DR_ACK |
+                                                  ADR_ANS_POWER_ACK);
+    adr_engine_on_link_adr_ans(&engine, DEV_ADDR, 0);
+    CHECK(dev->dr == target);
+    CHECK(!dev->pending);
+    adr_engine_free(&engine);
+}
+
+int main(void) {
+    test_eu868_mask();
+    test_us915_block(US915);
+    test_us915_block(AU915);
+
+    if(failures) {
+        printf("adr_engine: %d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("adr_engine: all tests passed\n");
+    return 0;
+}
@@ -0,0 +1,462 @@
+// Host tests for the TTN downlink stream and the irrigation command queue.
+// libcurl calls are stubbed below, but its headers are still needed; links
+// against the real cJSON (libcjson-dev and libcurl4-openssl-dev installed)
+//   cc -I.. -I/usr/include/cjson test_command_stream.c ../ttn_integration.c ../command_queue.c -lcjson -lpthread -o test_command_stream
+
+#include "command_queue.h"
+#include "ttn_integration.h"
+#include "security/key_management.h"
+#include <curl/curl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEV_A 0x260B0001u
+#define DEV_B 0x260B0002u
+#define STREAM_MAX 65536
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if(!(cond)) { \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while(0)
+
+// Gateway helpers the integration expects from the platform
+static uint32_t fake_now_ms = 0;
+
+uint32_t get_timestamp(void) {
+    return __atomic_load_n(&fake_now_ms, __ATOMIC_RELAXED);
+}
+
+void log_error(const char *fmt, ...) {
+    (void)fmt;
+}
+
+void log_warning(const char *fmt, ...) {
+    (void)fmt;
+}
+
+const char *get_ttn_api_key() {
+    return "test-key";
+}
+
+const char *get_gateway_id() {
+    return "test-gateway";
+}
+
+char *base64_encode(const uint8_t *data, size_t len) {
+    (void)data;
+    (void)len;
+    return calloc(1, 1);
+}
+
+static void encode_base64(const uint8_t *in, size_t len, char *out) {
+    static const char alphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t o = 0;
+    for(size_t i = 0; i < len; i += 3) {
+        uint32_t v = (uint32_t)in[i] << 16;
+        if(i + 1 < len) v |= (uint32_t)in[i + 1] << 8;
+        if(i + 2 < len) v |= in[i + 2];
+        out[o++] = alphabet[(v >> 18) & 63];
+        out[o++] = alphabet[(v >> 12) & 63];
+        out[o++] = i + 1 < len ? alphabet[(v >> 6) & 63] : '=';
+        out[o++] = i + 2 < len ? alphabet[v & 63] : '=';
+    }
+    out[o] = '\0';
+}
+
+// libcurl stub: perform() replays a scripted body through the write callback
+typedef size_t (*write_fn)(void *contents, size_t size, size_t nmemb, void *userp);
+
+static write_fn stream_write;
+static void *stream_user;
+static const char *stream_body;
+static size_t stream_chunk_max = 1;
+static int fake_handle;
+
+#undef curl_easy_setopt
+#undef curl_easy_getinfo
+
+CURL *curl_easy_init(void) {
+    return &fake_handle;
+}
+
+void curl_easy_cleanup(CURL *curl) {
+    (void)curl;
+}
+
+CURLcode curl_easy_setopt(CURL *curl, CURLoption option, ...) {
+    va_list args;
+    (void)curl;
+    va_start(args, option);
+    if(option == CURLOPT_WRITEFUNCTION) {
+        stream_write = va_arg(args, write_fn);
+    } else if(option == CURLOPT_WRITEDATA) {
+        stream_user = va_arg(args, void *);
+    }
+    va_end(args);
+    return CURLE_OK;
+}
+
+CURLcode curl_easy_getinfo(CURL *curl, CURLINFO info, ...) {
+    va_list args;
+    (void)curl;
+    va_start(args, info);
+    if(info == CURLINFO_RESPONSE_CODE) *va_arg(args, long *) = 200;
+    va_end(args);
+    return CURLE_OK;
+}
+
+// Odd-sized chunks split lines, JSON tokens and base64 at arbitrary points
+CURLcode curl_easy_perform(CURL *curl) {
+    (void)curl;
+    size_t len = strlen(stream_body);
+    size_t chunk = 1;
+    for(size_t off = 0; off < len; off += chunk) {
+        chunk = 1 + (off * 7919) % stream_chunk_max;
+        if(off + chunk > len) chunk = len - off;
+        stream_write((void *)(stream_body + off), 1, chunk, stream_user);
+        __atomic_fetch_add(&fake_now_ms, 1, __ATOMIC_RELAXED);
+    }
+    // Long-poll window closing is how a stream normally ends
+    return CURLE_OPERATION_TIMEDOUT;
+}
+
+struct curl_slist *curl_slist_append(struct curl_slist *list, const char *data) {
+    (void)data;
+    return list;
+}
+
+void curl_slist_free_all(struct curl_slist *list) {
+    (void)list;
+}
+
+const char *curl_easy_strerror(CURLcode code) {
+    (void)code;
+    return "stub";
+}
+
+// NDJSON builders
+static size_t add_command(char *buf, size_t off, uint32_t dev_addr, uint8_t zone,
+                          uint16_t duration, uint8_t priority) {
+    irrigation_command_t cmd = { .zone = zone, .duration = duration, .priority = priority };
+    char payload[16];
+    encode_base64((const uint8_t *)&cmd, sizeof(cmd), payload);
+    return off + (size_t)sprintf(buf + off,
+        "{\"result\":{\"end_device_ids\":{\"device_id\":\"valve-%u\",\"dev_addr\":\"%08X\"},"
+        "\"downlink_message\":{\"f_port\":%d,\"frm_payload\":\"%s\",\"priority\":\"HIGH\"}}}\n",
+        dev_addr & 0xFF, dev_addr, TTN_COMMAND_FPORT, payload);
+}
+
+static size_t add_line(char *buf, size_t off, const char *line) {
+    return off + (size_t)sprintf(buf + off, "%s\n", line);
+}
+
+// Mixed stream: commands for two devices plus everything that must be ignored
+static size_t build_stream(char *buf) {
+    size_t off = 0;
+    for(int i = 0; i < 40; i++) {
+        uint32_t dev = (i % 3 == 0) ? DEV_B : DEV_A;
+        off = add_command(buf, off, dev, (uint8_t)(i % 12), (uint16_t)(60 + i), (uint8_t)(i % 4));
+        if(i % 10 == 0) off = add_line(buf, off, "{}");
+    }
+    // No f_port: never an implicit command
+    off = add_line(buf, off, "{\"result\":{\"end_device_ids\":{\"dev_addr\":\"260B0001\"},"
+                             "\"downlink_message\":{\"frm_payload\":\"AwAAAQ==\"}}}");
+    // Other application port
+    off = add_line(buf, off, "{\"result\":{\"end_device_ids\":{\"dev_addr\":\"260B0001\"},"
+                             "\"downlink_message\":{\"f_port\":2,\"frm_payload\":\"AwAAAQ==\"}}}");
+    // No destination device
+    off = add_line(buf, off, "{\"result\":{\"downlink_message\":{\"f_port\":10,"
+                             "\"frm_payload\":\"AwAAAQ==\"}}}");
+    // Not JSON, and a payload that is not a whole number of commands
+    off = add_line(buf, off, "event: ping");
+    off = add_line(buf, off, "{\"result\":{\"end_device_ids\":{\"dev_addr\":\"260B0001\"},"
+                             "\"downlink_message\":{\"f_port\":10,\"frm_payload\":\"AwA=\"}}}");
+    return off;
+}
+
+static void feed_in_chunks(ttn_stream_t *stream, const char *data, size_t len, size_t chunk) {
+    for(size_t off = 0; off < len; off += chunk) {
+        size_t n = off + chunk <= len ? chunk : len - off;
+        ttn_stream_feed(stream, data + off, n);
+    }
+}
+
+static size_t drain(command_queue_t *q, uint32_t dev_addr) {
+    queued_command_t entry;
+    size_t n = 0;
+    while(command_queue_try_pop(q, dev_addr, &entry)) n++;
+    return n;
+}
+
+// Chunk boundaries must not change what is decoded
+static void test_chunk_splitting(void) {
+    static char body[STREAM_MAX];
+    size_t len = build_stream(body);
+    const size_t chunks[] = { 1, 2, 7, 64, 333, len };
+    size_t expect_a = 0, expect_b = 0;
+
+    for(size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+        command_queue_t q;
+        ttn_stream_t stream;
+        command_queue_init(&q);
+        ttn_stream_init(&stream, &q);
+
+        feed_in_chunks(&stream, body, len, chunks[c]);
+        CHECK(stream.messages == 40 + 4 + 4);
+        CHECK(stream.commands == 40);
+        CHECK(stream.malformed == 2);
+        CHECK(stream.unaddressed == 1);
+        CHECK(stream.len == 0);
+
+        size_t a = drain(&q, DEV_A);
+        size_t b = drain(&q, DEV_B);
+        if(c == 0) {
+            expect_a = a;
+            expect_b = b;
+        }
+        CHECK(a == expect_a && b == expect_b);
+        CHECK(command_queue_size(&q) == 0);
+        command_queue_destroy(&q);
+    }
+    // 12 zones; device B gets every third, so zones 0, 3, 6 and 9
+    CHECK(expect_a == 8 && expect_b == 4);
+}
+
+// A command is only ever handed out in its own device's receive window
+static void test_addressing(void) {
+    command_queue_t q;
+    queued_command_t entry;
+    irrigation_command_t low = { .zone = 1, .duration = 60, .priority = 1 };
+    irrigation_command_t high = { .zone = 2, .duration = 60, .priority = 5 };
+
+    command_queue_init(&q);
+    CHECK(command_queue_push(&q, DEV_A, &low, 0) == COMMAND_QUEUED);
+    CHECK(command_queue_push(&q, DEV_B, &high, 0) == COMMAND_QUEUED);
+
+    CHECK(command_queue_try_pop(&q, DEV_A, &entry));
+    CHECK(entry.dev_addr == DEV_A && entry.cmd.zone == 1);
+    CHECK(!command_queue_try_pop(&q, DEV_A, &entry));
+    CHECK(!command_queue_try_pop(&q, 0x260B0003u, &entry));
+    CHECK(command_queue_try_pop(&q, DEV_B, &entry));
+    CHECK(entry.dev_addr == DEV_B && entry.cmd.zone == 2);
+    command_queue_destroy(&q);
+}
+
+// Coalescing is per device and zone; the newest command wins
+static void test_coalescing(void) {
+    command_queue_t q;
+    queued_command_t entry;
+    irrigation_command_t run = { .zone = 3, .duration = 600, .priority = 2 };
+    irrigation_command_t stop = { .zone = 3, .duration = 0, .priority = 2 };
+    command_queue_stats_t stats;
+
+    command_queue_init(&q);
+    CHECK(command_queue_push(&q, DEV_A, &run, 0) == COMMAND_QUEUED);
+    CHECK(command_queue_push(&q, DEV_A, &run, 1) == COMMAND_DUPLICATE);
+    CHECK(command_queue_push(&q, DEV_B, &run, 2) == COMMAND_QUEUED);
+    CHECK(command_queue_push(&q, DEV_A, &stop, 3) == COMMAND_SUPERSEDED);
+    CHECK(command_queue_size(&q) == 2);
+
+    CHECK(command_queue_try_pop(&q, DEV_A, &entry));
+    CHECK(entry.cmd.duration == 0 && entry.enqueued_ms == 3);
+    CHECK(command_queue_try_pop(&q, DEV_B, &entry));
+    CHECK(entry.cmd.duration == 600);
+
+    command_queue_get_stats(&q, &stats);
+    CHECK(stats.enqueued == 2 && stats.duplicates == 1 && stats.superseded == 1);
+    command_queue_destroy(&q);
+}
+
+// A missed RX window must never bring back a command that was replaced meanwhile
+static void test_requeue_keeps_newer(void) {
+    command_queue_t q;
+    queued_command_t in_flight, entry;
+    irrigation_command_t run = { .zone = 3, .duration = 600, .priority = 2 };
+    irrigation_command_t stop = { .zone = 3, .duration = 0, .priority = 2 };
+
+    command_queue_init(&q);
+    command_queue_push(&q, DEV_A, &run, 10);
+    CHECK(command_queue_try_pop(&q, DEV_A, &in_flight));
+    CHECK(command_queue_push(&q, DEV_A, &stop, 20) == COMMAND_QUEUED);
+
+    CHECK(command_queue_requeue(&q, &in_flight) == COMMAND_STALE);
+    CHECK(command_queue_try_pop(&q, DEV_A, &entry));
+    CHECK(entry.cmd.duration == 0);
+    CHECK(!command_queue_try_pop(&q, DEV_A, &entry));
+    command_queue_destroy(&q);
+}
+
+// Without a newer command the requeued one keeps its place and arrival time
+static void test_requeue_restores(void) {
+    command_queue_t q;
+    queued_command_t in_flight, entry;
+    irrigation_command_t first = { .zone = 4, .duration = 60, .priority = 2 };
+    irrigation_command_t second = { .zone = 4, .duration = 60, .priority = 2 };
+    command_queue_stats_t stats;
+
+    command_queue_init(&q);
+    second.zone = 5;
+    command_queue_push(&q, DEV_A, &first, 10);
+    command_queue_push(&q, DEV_A, &second, 20);
+    CHECK(command_queue_try_pop(&q, DEV_A, &in_flight));
+    CHECK(in_flight.cmd.zone == 4);
+
+    CHECK(command_queue_requeue(&q, &in_flight) == COMMAND_QUEUED);
+    CHECK(command_queue_try_pop(&q, DEV_A, &entry));
+    CHECK(entry.cmd.zone == 4 && entry.enqueued_ms == 10 && entry.seq == in_flight.seq);
+
+    command_queue_get_stats(&q, &stats);
+    CHECK(stats.requeued == 1 && stats.stale == 0);
+    command_queue_destroy(&q);
+}
+
+// Latency runs from cloud arrival to the reported on-air start
+static void test_latency(void) {
+    command_queue_t q;
+    queued_command_t entry;
+    irrigation_command_t cmd = { .zone = 1, .duration = 60, .priority = 1 };
+    command_queue_stats_t stats;
+
+    command_queue_init(&q);
+    command_queue_push(&q, DEV_A, &cmd, 100);
+    CHECK(command_queue_try_pop(&q, DEV_A, &entry));
+    command_queue_record_air(&q, &entry, 1100);
+
+    cmd.zone = 2;
+    command_queue_push(&q, DEV_A, &cmd, 300);
+    CHECK(command_queue_try_pop(&q, DEV_A, &entry));
+    command_queue_record_air(&q, &entry, 2400);
+
+    command_queue_get_stats(&q, &stats);
+    CHECK(stats.latency_samples == 2);
+    CHECK(stats.latency_total_ms == 1000 + 2100);
+    CHECK(stats.latency_max_ms == 2100);
+    command_queue_destroy(&q);
+}
+
+// RX-window consumer racing the stream: try_pop never blocks, nothing is lost
+typedef struct {
+    command_queue_t *q;
+    bool done;
+    uint32_t popped;
+} consumer_t;
+
+static void *consume(void *arg) {
+    consumer_t *c = (consumer_t *)arg;
+    queued_command_t entry;
+    while(!__atomic_load_n(&c->done, __ATOMIC_ACQUIRE) || command_queue_size(c->q) > 0) {
+        for(uint32_t dev = DEV_A; dev <= DEV_B; dev++) {
+            if(command_queue_try_pop(c->q, dev, &entry)) {
+                command_queue_record_air(c->q, &entry, get_timestamp());
+                c->popped++;
+            }
+        }
+    }
+    return NULL;
+}
+
+static void test_stream_download(void) {
+    static char body[STREAM_MAX];
+    command_queue_t q;
+    command_queue_stats_t stats;
+    consumer_t consumer = { .q = &q };
+    pthread_t thread;
+
+    size_t off = 0;
+    for(int i = 0; i < 200; i++) {
+        off = add_command(body, off, (i & 1) ? DEV_B : DEV_A, (uint8_t)(i % 48),
+                          (uint16_t)(i * 3), (uint8_t)(i % 8));
+    }
+    // Final message arrives without its newline before the window closes
+    body[off - 1] = '\0';
+
+    command_queue_init(&q);
+    ttn_set_command_queue(&q);
+    pthread_create(&thread, NULL, consume, &consumer);
+
+    stream_body = body;
+    stream_chunk_max = 37;
+    CHECK(process_ttn_downlinks());
+
+    __atomic_store_n(&consumer.done, true, __ATOMIC_RELEASE);
+    pthread_join(thread, NULL);
+
+    command_queue_get_stats(&q, &stats);
+    CHECK(stats.enqueued + stats.duplicates + stats.superseded == 200);
+    CHECK(consumer.popped == stats.enqueued);
+    CHECK(stats.latency_samples == consumer.popped);
+    CHECK(command_queue_size(&q) == 0);
+    command_queue_destroy(&q);
+}
+
+// Radio loop queuing uplinks while the forwarder is stuck in a POST:
+// queuing never blocks, the oldest uplinks go first, order is kept
+static void test_uplink_queue(void) {
+    ttn_uplink_queue_t q;
+    ttn_uplink_t out;
+    uint8_t frame[TTN_UPLINK_MAX + 1];
+
+    ttn_uplink_queue_init(&q);
+    memset(frame, 0, sizeof(frame));
+    CHECK(!ttn_queue_uplink(&q, frame, 0));
+    CHECK(!ttn_queue_uplink(&q, frame, TTN_UPLINK_MAX + 1));
+    CHECK(q.count == 0);
+
+    for(int i = 0; i < TTN_UPLINK_QUEUE_SIZE + 3; i++) {
+        frame[0] = (uint8_t)i;
+        CHECK(ttn_queue_uplink(&q, frame, 12 + (size_t)i));
+    }
+    CHECK(q.count == TTN_UPLINK_QUEUE_SIZE);
+    CHECK(q.dropped == 3);
+
+    for(int i = 3; i < TTN_UPLINK_QUEUE_SIZE + 3; i++) {
+        ttn_uplink_pop(&q, &out);
+        CHECK(out.data[0] == (uint8_t)i);
+        CHECK(out.len == 12 + (size_t)i);
+    }
+    CHECK(q.count == 0);
+
+    // Wraps around the ring after draining
+    frame[0] = 0xAA;
+    CHECK(ttn_queue_uplink(&q, frame, TTN_UPLINK_MAX));
+    ttn_uplink_pop(&q, &out);
+    CHECK(out.data[0] == 0xAA && out.len == TTN_UPLINK_MAX);
+}
+
+// Registration announces the plan matching the radio's region
+static void test_frequency_plans(void) {
+    CHECK(strcmp(ttn_frequency_plan(EU868), "EU_863_870_TTN") == 0);
+    CHECK(strcmp(ttn_frequency_plan(US915), "US_902_928_FSB_1") == 0);
+    CHECK(strcmp(ttn_frequency_plan(AS923), "AS_923") == 0);
+    CHECK(strcmp(ttn_frequency_plan(AU915), "AU_915_928_FSB_1") == 0);
+    CHECK(strcmp(ttn_frequency_plan(IN865), "IN_865_867") == 0);
+    CHECK(ttn_frequency_plan((region_t)5) == NULL);
+    CHECK(!register_gateway_with_ttn((region_t)5));
+}
+
+int main(void) {
+    test_chunk_splitting();
+    test_addressing();
+    test_coalescing();
+    test_requeue_keeps_newer();
+    test_requeue_restores();
+    test_latency();
+    test_stream_download();
+    test_uplink_queue();
+    test_frequency_plans();
+
+    if(failures) {
+        printf("command_stream: %d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("command_stream: all tests passed\n");
+    return 0;
+}
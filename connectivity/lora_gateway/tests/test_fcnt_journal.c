@@ -0,0 +1,318 @@
+// Crash-recovery tests for the frame-counter journal on the host file backend
+//   cc -I../security test_fcnt_journal.c ../security/fcnt_journal.c ../security/journal_file.c ../security/device_registry.c -o test_fcnt_journal
+
+#include "fcnt_journal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define IMAGE_PATH "test_fcnt_journal.img"
+#define SECTOR_SIZE 1024
+#define SECTOR_COUNT 8
+#define DEVICES 16
+#define DEV_ADDR(d) (0x26010000u + (d))
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if(!(cond)) { \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while(0)
+
+// Session keys are opaque to the journal; trivial stand-ins keep the build self-contained
+void lorawan_aes_expand_key(const uint8_t *key, aes128_schedule_t *sched) {
+    memcpy(sched->round_keys, key, 16);
+}
+
+void lorawan_compute_mic_sched(const uint8_t *msg, size_t len, const aes128_schedule_t *sched,
+                               uint32_t dev_addr, uint32_t fcnt, uint8_t direction,
+                               uint8_t *mic) {
+    (void)msg; (void)len; (void)sched; (void)dev_addr; (void)fcnt; (void)direction;
+    memset(mic, 0, 4);
+}
+
+void derive_session_keys(const uint8_t *app_key, const uint8_t *dev_nonce,
+                         uint8_t *nwk_skey, uint8_t *app_skey) {
+    (void)dev_nonce;
+    memcpy(nwk_skey, app_key, 16);
+    memcpy(app_skey, app_key, 16);
+}
+
+// Counters the network server actually used (next value per direction)
+static uint32_t next_up[DEVICES];
+static uint32_t next_down[DEVICES];
+
+static void make_record(device_record_t *rec, uint32_t d) {
+    memset(rec, 0, sizeof(device_record_t));
+    rec->dev_addr = DEV_ADDR(d);
+    rec->dev_eui[0] = (uint8_t)d;
+    rec->dev_eui[7] = 0xEE;
+    rec->nwk_skey[0] = (uint8_t)(0xA0 + d);
+}
+
+static bool open_image(journal_storage_t *storage, fcnt_journal_t *j, bool fresh) {
+    if(fresh) remove(IMAGE_PATH);
+    if(!journal_file_storage_init(storage, IMAGE_PATH, SECTOR_SIZE, SECTOR_COUNT)) return false;
+    return fcnt_journal_open(j, storage, DEVICES);
+}
+
+// Power loss: buffered records are lost, nothing is flushed
+static void crash(journal_storage_t *storage, fcnt_journal_t *j) {
+    free(j->entries);
+    free(j->sector_seq);
+    memset(j, 0, sizeof(fcnt_journal_t));
+    journal_file_storage_close(storage);
+}
+
+// One frame each way, as the controller notes them
+static bool traffic(fcnt_journal_t *j, uint32_t d) {
+    bool ok = fcnt_journal_note_fcnt(j, DEV_ADDR(d), JOURNAL_DIR_UP, ++next_up[d]);
+    ok &= fcnt_journal_note_fcnt(j, DEV_ADDR(d), JOURNAL_DIR_DOWN, ++next_down[d]);
+    return ok;
+}
+
+// Restored counters must be within the recovery window of what was used
+static void check_restored(fcnt_journal_t *j, uint32_t removed_device) {
+    device_registry_t reg;
+    device_registry_init(&reg, DEVICES);
+
+    size_t restored = fcnt_journal_restore(j, &reg);
+    CHECK(restored == DEVICES - 1);
+
+    for(uint32_t d = 0; d < DEVICES; d++) {
+        const device_session_t *s = device_registry_find_addr(&reg, DEV_ADDR(d));
+        if(d == removed_device) {
+            CHECK(s == NULL);
+            continue;
+        }
+        CHECK(s != NULL);
+        if(!s) continue;
+
+        // Downlink jumps ahead: never reused, never more than one window ahead
+        CHECK(s->fcnt_down >= next_down[d]);
+        CHECK(s->fcnt_down <= next_down[d] + JOURNAL_FCNT_WINDOW);
+        // Uplink restores the last persisted value
+        CHECK(s->fcnt_up <= next_up[d]);
+        CHECK(next_up[d] - s->fcnt_up < JOURNAL_FCNT_WINDOW);
+        CHECK(s->nwk_skey[0] == (uint8_t)(0xA0 + d));
+    }
+    device_registry_free(&reg);
+}
+
+// A journal that failed to open must reject calls instead of crashing
+static void test_unopened(void) {
+    fcnt_journal_t j;
+    device_registry_t reg;
+    device_record_t rec;
+
+    memset(&j, 0, sizeof(j));
+    make_record(&rec, 0);
+    device_registry_init(&reg, DEVICES);
+
+    CHECK(!fcnt_journal_note_fcnt(&j, DEV_ADDR(0), JOURNAL_DIR_DOWN, 100));
+    CHECK(!fcnt_journal_write_session(&j, &rec));
+    CHECK(!fcnt_journal_remove(&j, DEV_ADDR(0)));
+    CHECK(!fcnt_journal_flush(&j));
+    CHECK(!fcnt_journal_maintain(&j));
+    CHECK(fcnt_journal_restore(&j, &reg) == 0);
+    fcnt_journal_close(&j);
+
+    device_registry_free(&reg);
+}
+
+// Appends never erase; without maintain the ring fills and refuses writes
+static void test_no_erase_on_append(void) {
+    journal_storage_t storage;
+    fcnt_journal_t j;
+    device_record_t rec;
+
+    memset(next_up, 0, sizeof(next_up));
+    memset(next_down, 0, sizeof(next_down));
+    CHECK(open_image(&storage, &j, true));
+    uint32_t erased = j.sectors_erased;
+
+    make_record(&rec, 0);
+    CHECK(fcnt_journal_write_session(&j, &rec));
+    CHECK(j.sectors_erased == erased);
+
+    bool full = false;
+    for(uint32_t i = 0; i < 100000 && !full; i++) {
+        full = !traffic(&j, 0);
+    }
+    CHECK(full);
+    CHECK(j.sectors_erased == SECTOR_COUNT - JOURNAL_MIN_FREE_SECTORS);
+
+    // Housekeeping frees space again
+    CHECK(fcnt_journal_maintain(&j));
+    CHECK(j.sectors_erased > SECTOR_COUNT - JOURNAL_MIN_FREE_SECTORS);
+
+    fcnt_journal_close(&j);
+    journal_file_storage_close(&storage);
+}
+
+// Storage that fails programs on demand; reads and erases pass through
+static int (*real_program)(void *ctx, uint32_t offset, const void *buf, size_t len);
+static bool program_fails;
+
+static int flaky_program(void *ctx, uint32_t offset, const void *buf, size_t len) {
+    if(program_fails) return -1;
+    return real_program(ctx, offset, buf, len);
+}
+
+// A failed flush keeps the records buffered at the same offset and retries
+static void test_flush_failure(void) {
+    journal_storage_t storage;
+    fcnt_journal_t j;
+    device_record_t rec;
+
+    memset(next_up, 0, sizeof(next_up));
+    memset(next_down, 0, sizeof(next_down));
+    CHECK(open_image(&storage, &j, true));
+    real_program = j.storage.program;
+    j.storage.program = flaky_program;
+
+    for(uint32_t d = 0; d < DEVICES; d++) {
+        make_record(&rec, d);
+        CHECK(fcnt_journal_write_session(&j, &rec));
+    }
+    CHECK(fcnt_journal_flush(&j));
+
+    for(uint32_t d = 0; d < DEVICES; d++) {
+        next_up[d] = JOURNAL_FCNT_STRIDE - 1;
+        next_down[d] = JOURNAL_FCNT_STRIDE - 1;
+        CHECK(traffic(&j, d));
+    }
+    uint32_t buffered = j.buffer_len;
+    uint32_t offset = j.head_offset;
+    uint32_t gen = j.flush_gen;
+    CHECK(buffered > 0);
+
+    program_fails = true;
+    CHECK(!fcnt_journal_flush(&j));
+    CHECK(!fcnt_journal_maintain(&j));
+    CHECK(j.buffer_len == buffered);
+    CHECK(j.head_offset == offset);
+    CHECK(j.flush_gen == gen);
+
+    program_fails = false;
+    CHECK(fcnt_journal_maintain(&j));
+    CHECK(j.buffer_len == 0);
+    CHECK(j.head_offset == offset + buffered);
+    crash(&storage, &j);
+
+    // Nothing buffered was lost
+    device_registry_t reg;
+    device_registry_init(&reg, DEVICES);
+    CHECK(open_image(&storage, &j, false));
+    CHECK(fcnt_journal_restore(&j, &reg) == DEVICES);
+    for(uint32_t d = 0; d < DEVICES; d++) {
+        const device_session_t *s = device_registry_find_addr(&reg, DEV_ADDR(d));
+        CHECK(s && s->fcnt_up == JOURNAL_FCNT_STRIDE);
+        CHECK(s && s->fcnt_down == JOURNAL_FCNT_STRIDE + JOURNAL_FCNT_WINDOW);
+    }
+    device_registry_free(&reg);
+    fcnt_journal_close(&j);
+    journal_file_storage_close(&storage);
+}
+
+// Wrap the ring several times, crash with records still buffered, restore
+static void test_crash_after_wrap(void) {
+    journal_storage_t storage;
+    fcnt_journal_t j;
+    device_record_t rec;
+    uint32_t removed_device = 5;
+
+    memset(next_up, 0, sizeof(next_up));
+    memset(next_down, 0, sizeof(next_down));
+    CHECK(open_image(&storage, &j, true));
+
+    for(uint32_t d = 0; d < DEVICES; d++) {
+        make_record(&rec, d);
+        CHECK(fcnt_journal_write_session(&j, &rec));
+    }
+
+    uint32_t rng = 7;
+    for(uint32_t i = 0; i < 50000; i++) {
+        rng = rng * 1664525u + 1013904223u;
+        uint32_t d = (rng >> 16) % DEVICES;
+        if(i == 20000) {
+            CHECK(fcnt_journal_remove(&j, DEV_ADDR(removed_device)));
+        }
+        if(d != removed_device || i < 20000) {
+            CHECK(traffic(&j, d));
+        }
+
+        // Control loop runs housekeeping after each packet
+        CHECK(fcnt_journal_maintain(&j));
+    }
+    CHECK(j.sectors_erased > 3 * SECTOR_COUNT);
+
+    // Last frames never reach flash
+    for(uint32_t d = 0; d < DEVICES; d++) {
+        if(d != removed_device) CHECK(traffic(&j, d));
+    }
+    CHECK(j.buffer_len > 0);
+    crash(&storage, &j);
+
+    CHECK(open_image(&storage, &j, false));
+    check_restored(&j, removed_device);
+    fcnt_journal_close(&j);
+    journal_file_storage_close(&storage);
+}
+
+// Power loss mid-program leaves a torn record at the head
+static void test_torn_head(void) {
+    journal_storage_t storage;
+    fcnt_journal_t j;
+    uint32_t removed_device = 5;
+
+    // Continues from the image and counters left by test_crash_after_wrap
+    CHECK(open_image(&storage, &j, false));
+    for(uint32_t d = 0; d < DEVICES; d++) {
+        if(d == removed_device) continue;
+        for(uint32_t n = 0; n < 40; n++) traffic(&j, d);
+        CHECK(fcnt_journal_maintain(&j));
+    }
+
+    // Header and half a payload of a counter record, CRC never written
+    uint32_t torn_head = j.head;
+    uint32_t loc = j.head * SECTOR_SIZE + j.head_offset;
+    uint8_t torn[10] = {0x02, 12, 0xFF, 0xFF, 0x01, 0x00, 0x01, 0x26, 0x40, 0x00};
+    CHECK(storage.program(storage.ctx, loc, torn, sizeof(torn)) == 0);
+    crash(&storage, &j);
+
+    CHECK(open_image(&storage, &j, false));
+    CHECK(j.head != torn_head);
+    check_restored(&j, removed_device);
+
+    // Journal keeps working past the torn record and survives another crash
+    for(uint32_t d = 0; d < DEVICES; d++) {
+        if(d == removed_device) continue;
+        CHECK(traffic(&j, d));
+        CHECK(fcnt_journal_maintain(&j));
+    }
+    crash(&storage, &j);
+
+    CHECK(open_image(&storage, &j, false));
+    check_restored(&j, removed_device);
+    fcnt_journal_close(&j);
+    journal_file_storage_close(&storage);
+}
+
+int main(void) {
+    test_unopened();
+    test_no_erase_on_append();
+    test_flush_failure();
+    test_crash_after_wrap();
+    test_torn_head();
+    remove(IMAGE_PATH);
+
+    if(failures) {
+        printf("fcnt_journal: %d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("fcnt_journal: all tests passed\n");
+    return 0;
+}
@@ -0,0 +1,331 @@
+// Host tests for the TX scheduler against a simulated radio
+//   cc -I.. test_tx_scheduler.c ../tx_scheduler.c -o test_tx_scheduler
+
+#include "tx_scheduler.h"
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_SENT 256
+#define RX2_FREQ_HZ 869525000u
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if(!(cond)) { \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while(0)
+
+// Simulated radio: records every frame and when it went on air
+typedef struct {
+    uint32_t handed_at;        // Scheduler time of the send() call
+    uint32_t start;            // On-air start
+    uint32_t freq_hz;
+    uint8_t dr;
+    size_t len;
+} sim_tx_t;
+
+typedef struct {
+    region_t region;
+    uint32_t now;
+    uint32_t busy_until;
+    int overlaps;
+    sim_tx_t sent[MAX_SENT];
+    int count;
+} sim_radio_t;
+
+static bool sim_send(void *ctx, const uint8_t *data, size_t len,
+                     uint32_t freq_hz, uint8_t dr, uint32_t tx_at_ms) {
+    sim_radio_t *radio = (sim_radio_t *)ctx;
+    (void)data;
+
+    uint32_t start = tx_at_ms ? tx_at_ms : radio->now;
+    if((int32_t)(start - radio->busy_until) < 0) radio->overlaps++;
+    radio->busy_until = start + tx_time_on_air_ms(radio->region, dr, len, tx_at_ms != 0);
+
+    if(radio->count < MAX_SENT) {
+        sim_tx_t *tx = &radio->sent[radio->count++];
+        tx->handed_at = radio->now;
+        tx->start = start;
+        tx->freq_hz = freq_hz;
+        tx->dr = dr;
+        tx->len = len;
+    }
+    return true;
+}
+
+static void setup_region(tx_scheduler_t *s, sim_radio_t *radio, region_t region, uint32_t now) {
+    memset(radio, 0, sizeof(sim_radio_t));
+    radio->region = region;
+    radio->now = now;
+    tx_scheduler_init(s, region, sim_send, radio);
+}
+
+static void setup(tx_scheduler_t *s, sim_radio_t *radio, uint32_t now) {
+    setup_region(s, radio, EU868, now);
+}
+
+// Service the scheduler every millisecond up to end_ms
+static void run_until(tx_scheduler_t *s, sim_radio_t *radio, uint32_t end_ms) {
+    for(; radio->now <= end_ms; radio->now++) {
+        tx_scheduler_service(s, radio->now);
+    }
+}
+
+static void uplink_meta(lora_rx_meta_t *meta, uint32_t timestamp, uint32_t freq_hz, uint8_t dr) {
+    memset(meta, 0, sizeof(lora_rx_meta_t));
+    meta->timestamp = timestamp;
+    meta->freq_hz = freq_hz;
+    meta->datarate = dr;
+}
+
+// Short ASAP frame on the g sub-band (1 %): off for 100x its airtime, radio idle again soon
+static void exhaust_band_g(tx_scheduler_t *s, sim_radio_t *radio) {
+    uint8_t frame[20] = {0};
+    tx_window_t window = {
+        .freq_hz = 868300000,
+        .dr = 5,
+        .not_before_ms = radio->now,
+        .deadline_ms = radio->now + 100
+    };
+    CHECK(tx_scheduler_enqueue(s, frame, sizeof(frame), TX_PRIO_TELEMETRY, &window, NULL,
+                               TX_TAG_NONE));
+    run_until(s, radio, radio->now + 100);
+    CHECK(radio->count == 1);
+}
+
+// Within budget the downlink goes out in RX1, on the uplink channel and DR
+static void test_rx1(void) {
+    tx_scheduler_t s;
+    sim_radio_t radio;
+    lora_rx_meta_t uplink;
+    uint8_t frame[17] = {0};
+
+    setup(&s, &radio, 1000);
+    uplink_meta(&uplink, 1000, 868100000, 5);
+    CHECK(tx_scheduler_enqueue_class_a(&s, frame, sizeof(frame), TX_PRIO_DOWNLINK,
+                                       &uplink, RECEIVE_DELAY1_MS, TX_TAG_NONE));
+    run_until(&s, &radio, 4000);
+
+    CHECK(radio.count == 1);
+    CHECK(radio.sent[0].start == 1000 + RECEIVE_DELAY1_MS);
+    CHECK(radio.sent[0].freq_hz == 868100000);
+    CHECK(radio.sent[0].dr == 5);
+    CHECK(radio.sent[0].handed_at == radio.sent[0].start - TX_LEAD_MS);
+    CHECK(s.stats.rx2_fallbacks == 0);
+    CHECK(tx_scheduler_pending(&s) == 0);
+}
+
+// RX1's sub-band is out of budget: the frame moves to RX2 (869.525 MHz, DR0)
+static void test_rx2_fallback(void) {
+    tx_scheduler_t s;
+    sim_radio_t radio;
+    lora_rx_meta_t uplink;
+    uint8_t frame[17] = {0};
+
+    setup(&s, &radio, 1000);
+    exhaust_band_g(&s, &radio);
+
+    uint32_t rx_end = radio.now;
+    uplink_meta(&uplink, rx_end, 868100000, 5);
+    CHECK(tx_scheduler_enqueue_class_a(&s, frame, sizeof(frame), TX_PRIO_DOWNLINK,
+                                       &uplink, RECEIVE_DELAY1_MS, TX_TAG_NONE));
+    run_until(&s, &radio, rx_end + 4000);
+
+    CHECK(radio.count == 2);
+    CHECK(radio.sent[1].freq_hz == RX2_FREQ_HZ);
+    CHECK(radio.sent[1].dr == 0);
+    CHECK(radio.sent[1].start == rx_end + RECEIVE_DELAY1_MS + 1000);
+    CHECK(s.stats.rx2_fallbacks == 1);
+    CHECK(s.stats.duty_deferrals >= 1);
+    CHECK(s.stats.dropped_deadline == 0);
+    CHECK(radio.overlaps == 0);
+}
+
+// Neither window fits: the frame is dropped rather than sent late
+static void test_both_windows_blocked(void) {
+    tx_scheduler_t s;
+    sim_radio_t radio;
+    lora_rx_meta_t uplink;
+    uint8_t frame[17] = {0};
+
+    setup(&s, &radio, 1000);
+    exhaust_band_g(&s, &radio);
+
+    // Burn the RX2 band (10 %) as well
+    uint32_t rx_end = radio.now;
+    uplink_meta(&uplink, rx_end, 868100000, 5);
+    CHECK(tx_scheduler_enqueue_class_a(&s, frame, sizeof(frame), TX_PRIO_DOWNLINK,
+                                       &uplink, RECEIVE_DELAY1_MS, TX_TAG_NONE));
+    run_until(&s, &radio, rx_end + 2100);
+    CHECK(radio.count == 2);
+
+    uplink_meta(&uplink, radio.now, 868100000, 5);
+    CHECK(tx_scheduler_enqueue_class_a(&s, frame, sizeof(frame), TX_PRIO_DOWNLINK,
+                                       &uplink, RECEIVE_DELAY1_MS, TX_TAG_NONE));
+    run_until(&s, &radio, radio.now + 4000);
+
+    CHECK(radio.count == 2);
+    CHECK(s.stats.dropped_deadline == 1);
+    CHECK(tx_scheduler_pending(&s) == 0);
+}
+
+// Tagged frames report when they actually went on air, or that they were dropped
+typedef struct {
+    int reports;
+    uint32_t tag;
+    bool sent;
+    uint32_t air_ms;
+} done_log_t;
+
+static void log_done(void *ctx, uint32_t tag, bool sent, uint32_t air_ms) {
+    done_log_t *log = (done_log_t *)ctx;
+    log->reports++;
+    log->tag = tag;
+    log->sent = sent;
+    log->air_ms = air_ms;
+}
+
+static void test_done_hook(void) {
+    tx_scheduler_t s;
+    sim_radio_t radio;
+    lora_rx_meta_t uplink;
+    done_log_t log = {0};
+    uint8_t frame[17] = {0};
+
+    setup(&s, &radio, 1000);
+    tx_scheduler_set_done_hook(&s, log_done, &log);
+    exhaust_band_g(&s, &radio);
+    CHECK(log.reports == 0);
+
+    uint32_t rx_end = radio.now;
+    uplink_meta(&uplink, rx_end, 868100000, 5);
+    CHECK(tx_scheduler_enqueue_class_a(&s, frame, sizeof(frame), TX_PRIO_COMMAND,
+                                       &uplink, RECEIVE_DELAY1_MS, 7));
+    run_until(&s, &radio, rx_end + 4000);
+    CHECK(log.reports == 1);
+    CHECK(log.tag == 7);
+    CHECK(log.sent);
+    CHECK(log.air_ms == rx_end + RECEIVE_DELAY1_MS + 1000);
+
+    // Both windows blocked now: dropped inside the scheduler, still reported
+    uplink_meta(&uplink, radio.now, 868100000, 5);
+    CHECK(tx_scheduler_enqueue_class_a(&s, frame, sizeof(frame), TX_PRIO_COMMAND,
+                                       &uplink, RECEIVE_DELAY1_MS, 8));
+    run_until(&s, &radio, radio.now + 4000);
+    CHECK(log.reports == 2);
+    CHECK(log.tag == 8);
+    CHECK(!log.sent);
+}
+
+// US915: RX1 on the mapped 500 kHz downlink channel, own frames in sub-band 1
+static void test_us915(void) {
+    tx_scheduler_t s;
+    sim_radio_t radio;
+    lora_rx_meta_t uplink;
+    uint8_t frame[17] = {0};
+
+    CHECK(tx_region_default_freq_hz(EU868) == 868100000);
+    CHECK(tx_region_default_freq_hz(US915) == 902300000);
+    CHECK(tx_region_default_freq_hz(AU915) == 915200000);
+    CHECK(tx_region_default_freq_hz(AS923) == 923200000);
+    CHECK(tx_region_default_freq_hz(IN865) == 865062500);
+
+    setup_region(&s, &radio, US915, 1000);
+    tx_window_t window = {
+        .freq_hz = tx_region_default_freq_hz(US915),
+        .dr = 3,
+        .not_before_ms = radio.now,
+        .deadline_ms = radio.now + 100
+    };
+    CHECK(tx_scheduler_enqueue(&s, frame, sizeof(frame), TX_PRIO_TELEMETRY, &window, NULL,
+                               TX_TAG_NONE));
+    run_until(&s, &radio, radio.now + 100);
+    CHECK(radio.count == 1);
+    CHECK(radio.sent[0].freq_hz == 902300000);
+
+    // Uplink on channel 2 (902.7 MHz, DR0) maps to downlink channel 2 at DR10
+    uint32_t rx_end = radio.now;
+    uplink_meta(&uplink, rx_end, 902700000, 0);
+    CHECK(tx_scheduler_enqueue_class_a(&s, frame, sizeof(frame), TX_PRIO_DOWNLINK,
+                                       &uplink, RECEIVE_DELAY1_MS, TX_TAG_NONE));
+    run_until(&s, &radio, rx_end + 4000);
+
+    CHECK(radio.count == 2);
+    CHECK(radio.sent[1].freq_hz == 924500000);
+    CHECK(radio.sent[1].dr == 10);
+    CHECK(radio.sent[1].start == rx_end + RECEIVE_DELAY1_MS);
+    CHECK(s.stats.rx2_fallbacks == 0);
+    CHECK(radio.overlaps == 0);
+}
+
+// ASAP frames wait out the sub-band off-time instead of breaking the duty cycle
+static void test_duty_deferral(void) {
+    tx_scheduler_t s;
+    sim_radio_t radio;
+    uint8_t frame[20] = {0};
+    tx_window_t window = {
+        .freq_hz = 868100000,
+        .dr = 0,
+        .not_before_ms = 1000,
+        .deadline_ms = 1000 + 600000
+    };
+
+    setup(&s, &radio, 1000);
+    CHECK(tx_scheduler_enqueue(&s, frame, sizeof(frame), TX_PRIO_TELEMETRY, &window, NULL,
+                               TX_TAG_NONE));
+    CHECK(tx_scheduler_enqueue(&s, frame, sizeof(frame), TX_PRIO_TELEMETRY, &window, NULL,
+                               TX_TAG_NONE));
+    run_until(&s, &radio, 1000 + 600000);
+
+    uint32_t airtime = tx_time_on_air_ms(EU868, 0, sizeof(frame), false);
+    CHECK(radio.count == 2);
+    CHECK(radio.sent[0].start == 1000);
+    CHECK(radio.sent[1].start == 1000 + airtime * 100);
+    CHECK(s.stats.dropped_deadline == 0);
+}
+
+// A saturating load never exceeds 1 % airtime in the g sub-band over an hour
+static void test_duty_budget(void) {
+    tx_scheduler_t s;
+    sim_radio_t radio;
+    uint8_t frame[33] = {0};
+
+    setup(&s, &radio, 1);
+    for(; radio.now < 3600000; radio.now++) {
+        if(radio.now % 1000 == 0) {
+            tx_window_t window = {
+                .freq_hz = 868100000 + (radio.now / 1000 % 3) * 200000,
+                .dr = 5,
+                .not_before_ms = radio.now,
+                .deadline_ms = radio.now + 5000
+            };
+            tx_scheduler_enqueue(&s, frame, sizeof(frame), TX_PRIO_TELEMETRY, &window, NULL,
+                                 TX_TAG_NONE);
+        }
+        tx_scheduler_service(&s, radio.now);
+    }
+
+    CHECK(s.stats.sent > 0);
+    CHECK(s.stats.dropped_deadline > 0);
+    CHECK(s.bands[0].airtime_ms <= 36000);
+    CHECK(radio.overlaps == 0);
+}
+
+int main(void) {
+    test_rx1();
+    test_rx2_fallback();
+    test_both_windows_blocked();
+    test_done_hook();
+    test_us915();
+    test_duty_deferral();
+    test_duty_budget();
+
+    if(failures) {
+        printf("tx_scheduler: %d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("tx_scheduler: all tests passed\n");
+    return 0;
+}
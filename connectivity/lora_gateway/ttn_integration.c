@@ -1,11 +1,34 @@
 #include "lora_protocol.h"
+#include "ttn_integration.h"
 #include "security/key_management.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <curl/curl.h>
 #include <cJSON.h>
 
 // TTN API Configuration
 #define TTN_BASE_URL "https://eu1.cloud.thethings.network/api/v3"
 #define TTN_TIMEOUT_MS 5000
+#define TTN_MAX_PAYLOAD 242
+
+static command_queue_t *command_queue = NULL;
+
+// TTN frequency plan per region; US915/AU915 use sub-band 1 like the radio
+static const char *const frequency_plans[] = {
+    [EU868] = "EU_863_870_TTN",
+    [US915] = "US_902_928_FSB_1",
+    [AS923] = "AS_923",
+    [AU915] = "AU_915_928_FSB_1",
+    [IN865] = "IN_865_867",
+};
+
+const char *ttn_frequency_plan(region_t region) {
+    if((unsigned)region >= sizeof(frequency_plans) / sizeof(frequency_plans[0])) {
+        return NULL;
+    }
+    return frequency_plans[region];
+}
 
 // Write callback for CURL
 static size_t curl_write_cb(void *contents, size_t size, size_t nmemb, void *userp) {
@@ -88,20 +111,313 @@ bool forward_to_ttn(const uint8_t *packet, size_t len) {
     return success;
 }
 
-// Process Downlinks from TTN
-void process_ttn_downlinks() {
+void ttn_uplink_queue_init(ttn_uplink_queue_t *q) {
+    memset(q, 0, sizeof(ttn_uplink_queue_t));
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->ready, NULL);
+}
+
+// Called from the radio loop: copy and return, the POST happens elsewhere
+bool ttn_queue_uplink(ttn_uplink_queue_t *q, const uint8_t *packet, size_t len) {
+    if(len == 0 || len > TTN_UPLINK_MAX) return false;
+    
+    pthread_mutex_lock(&q->lock);
+    if(q->count == TTN_UPLINK_QUEUE_SIZE) {
+        q->head = (q->head + 1) % TTN_UPLINK_QUEUE_SIZE;
+        q->count--;
+        q->dropped++;
+    }
+    ttn_uplink_t *slot = &q->slots[(q->head + q->count) % TTN_UPLINK_QUEUE_SIZE];
+    memcpy(slot->data, packet, len);
+    slot->len = len;
+    q->count++;
+    pthread_cond_signal(&q->ready);
+    pthread_mutex_unlock(&q->lock);
+    return true;
+}
+
+// Forwarder side: blocks until an uplink is queued
+void ttn_uplink_pop(ttn_uplink_queue_t *q, ttn_uplink_t *out) {
+    pthread_mutex_lock(&q->lock);
+    while(q->count == 0) {
+        pthread_cond_wait(&q->ready, &q->lock);
+    }
+    memcpy(out, &q->slots[q->head], sizeof(ttn_uplink_t));
+    q->head = (q->head + 1) % TTN_UPLINK_QUEUE_SIZE;
+    q->count--;
+    pthread_mutex_unlock(&q->lock);
+}
+
+// Decode standard base64 (returns bytes written, 0 on malformed input)
+static size_t base64_decode_into(const char *in, uint8_t *out, size_t out_size) {
+    uint32_t acc = 0;
+    int bits = 0;
+    size_t len = 0;
+    
+    for(; *in && *in != '='; in++) {
+        char c = *in;
+        int v;
+        if(c >= 'A' && c <= 'Z') v = c - 'A';
+        else if(c >= 'a' && c <= 'z') v = c - 'a' + 26;
+        else if(c >= '0' && c <= '9') v = c - '0' + 52;
+        else if(c == '+') v = 62;
+        else if(c == '/') v = 63;
+        else return 0;
+        
+        acc = (acc << 6) | (uint32_t)v;
+        bits += 6;
+        if(bits >= 8) {
+            bits -= 8;
+            if(len == out_size) return 0;
+            out[len++] = (acc >> bits) & 0xFF;
+        }
+    }
+    return len;
+}
+
+// DevAddr from "end_device_ids": {"dev_addr": "260B1234"} (hex, MSB first)
+static bool find_dev_addr(const cJSON *msg, uint32_t *dev_addr) {
+    const cJSON *ids = cJSON_GetObjectItemCaseSensitive(msg, "end_device_ids");
+    const cJSON *addr = cJSON_GetObjectItemCaseSensitive(ids, "dev_addr");
+    if(!cJSON_IsString(addr) || strlen(addr->valuestring) != 8) return false;
+    
+    char *end;
+    unsigned long value = strtoul(addr->valuestring, &end, 16);
+    if(*end != '\0') return false;
+    *dev_addr = (uint32_t)value;
+    return true;
+}
+
+// Locate the FRMPayload in a TTN v3 downlink message (stream items are wrapped in "result")
+static const cJSON *find_downlink(const cJSON *root, int *f_port, uint32_t *dev_addr,
+                                  bool *addressed) {
+    const cJSON *msg = cJSON_GetObjectItemCaseSensitive(root, "result");
+    if(!msg) msg = root;
+    *addressed = find_dev_addr(msg, dev_addr);
+    
+    const char *wrappers[] = { "downlink_message", "downlink", NULL };
+    for(int i = 0; wrappers[i]; i++) {
+        const cJSON *inner = cJSON_GetObjectItemCaseSensitive(msg, wrappers[i]);
+        if(cJSON_IsObject(inner)) {
+            msg = inner;
+            break;
+        }
+    }
+    if(!*addressed) *addressed = find_dev_addr(msg, dev_addr);
+    
+    // No f_port means no application payload, never an implicit command port
+    const cJSON *port = cJSON_GetObjectItemCaseSensitive(msg, "f_port");
+    *f_port = cJSON_IsNumber(port) ? port->valueint : -1;
+    
+    const cJSON *payload = cJSON_GetObjectItemCaseSensitive(msg, "frm_payload");
+    if(!payload) payload = cJSON_GetObjectItemCaseSensitive(msg, "payload");
+    return cJSON_IsString(payload) ? payload : NULL;
+}
+
+// Decode one NDJSON message into queued irrigation commands
+static void handle_stream_line(ttn_stream_t *stream, const char *line) {
+    cJSON *root = cJSON_Parse(line);
+    if(!root) {
+        stream->malformed++;
+        return;
+    }
+    stream->messages++;
+    
+    int f_port;
+    uint32_t dev_addr = 0;
+    bool addressed;
+    const cJSON *payload = find_downlink(root, &f_port, &dev_addr, &addressed);
+    uint8_t raw[TTN_MAX_PAYLOAD];
+    size_t raw_len = payload ? base64_decode_into(payload->valuestring, raw, sizeof(raw)) : 0;
+    
+    if(!payload || f_port != TTN_COMMAND_FPORT) {
+        // Keep-alive or not an irrigation command
+    } else if(raw_len == 0 || raw_len % sizeof(irrigation_command_t) != 0) {
+        stream->malformed++;
+    } else if(!addressed) {
+        // Commands are only ever sent in the addressed device's RX window
+        stream->unaddressed++;
+    } else if(stream->queue) {
+        uint32_t now = get_timestamp();
+        for(size_t off = 0; off < raw_len; off += sizeof(irrigation_command_t)) {
+            irrigation_command_t cmd;
+            memcpy(&cmd, raw + off, sizeof(cmd));
+            if(command_queue_push(stream->queue, dev_addr, &cmd, now) == COMMAND_REJECTED) {
+                log_warning("Command queue full, zone %d dropped", cmd.zone);
+            }
+            stream->commands++;
+        }
+    }
+    
+    cJSON_Delete(root);
+}
+
+void ttn_stream_init(ttn_stream_t *stream, command_queue_t *queue) {
+    memset(stream, 0, sizeof(ttn_stream_t));
+    stream->queue = queue;
+}
+
+/**
+ * Feed raw stream bytes; complete lines are decoded as they arrive
+ *
+ * @param stream Decoder state (carries partial lines between calls)
+ * @param data Received bytes, any chunking
+ * @param len Number of bytes
+ * @return Bytes consumed (always len)
+ */
+size_t ttn_stream_feed(ttn_stream_t *stream, const char *data, size_t len) {
+    const char *end = data + len;
+    
+    while(data < end) {
+        const char *nl = memchr(data, '\n', end - data);
+        size_t chunk = (nl ? nl : end) - data;
+        
+        if(!stream->overflow) {
+            if(stream->len + chunk < TTN_LINE_MAX) {
+                memcpy(stream->line + stream->len, data, chunk);
+                stream->len += chunk;
+            } else {
+                stream->overflow = true;
+                stream->malformed++;
+            }
+        }
+        if(!nl) break;
+        
+        if(!stream->overflow && stream->len > 0) {
+            stream->line[stream->len] = '\0';
+            handle_stream_line(stream, stream->line);
+        }
+        stream->len = 0;
+        stream->overflow = false;
+        data = nl + 1;
+    }
+    return len;
+}
+
+// Streaming write callback: decode as bytes arrive, never buffer the whole body
+static size_t curl_stream_cb(void *contents, size_t size, size_t nmemb, void *userp) {
+    return ttn_stream_feed((ttn_stream_t *)userp, contents, size * nmemb);
+}
+
+void ttn_set_command_queue(command_queue_t *queue) {
+    command_queue = queue;
+}
+
+// Process Downlinks from TTN (one long-poll stream; call in a loop)
+bool process_ttn_downlinks() {
+    CURL *curl = curl_easy_init();
+    if(!curl) return false;
+    
     char url[256];
+    char auth_header[128];
     snprintf(url, sizeof(url), "%s/gs/gateways/%s/packages/down", 
              TTN_BASE_URL, get_gateway_id());
+    snprintf(auth_header, sizeof(auth_header), "Authorization: Bearer %s", get_ttn_api_key());
+    
+    struct curl_slist *headers = NULL;
+    headers = curl_slist_append(headers, "Accept: application/x-ndjson");
+    headers = curl_slist_append(headers, auth_header);
+    
+    ttn_stream_t *stream = malloc(sizeof(ttn_stream_t));
+    if(!stream) {
+        curl_slist_free_all(headers);
+        curl_easy_cleanup(curl);
+        return false;
+    }
+    ttn_stream_init(stream, command_queue);
+    
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, curl_stream_cb);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, stream);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, TTN_TIMEOUT_MS);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, TTN_STREAM_TIMEOUT_MS);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    
+    CURLcode res = curl_easy_perform(curl);
+    
+    long status = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+    
+    // A trailing message without newline still counts
+    if(stream->len > 0 && !stream->overflow) {
+        stream->line[stream->len] = '\0';
+        handle_stream_line(stream, stream->line);
+    }
+    
+    if(stream->malformed > 0) {
+        log_warning("TTN stream: %u malformed messages", stream->malformed);
+    }
+    if(stream->unaddressed > 0) {
+        log_warning("TTN stream: %u commands without DevAddr", stream->unaddressed);
+    }
     
-    // Similar CURL implementation for GET request
-    // ...
+    curl_slist_free_all(headers);
+    curl_easy_cleanup(curl);
+    free(stream);
     
-    // Parse downlink packets and add to queue
+    // The long-poll window closing is the normal end of a stream
+    if(res != CURLE_OK && res != CURLE_OPERATION_TIMEDOUT) {
+        log_error("TTN downlink stream failed: %s", curl_easy_strerror(res));
+        return false;
+    }
+    return status == 200;
 }
 
-// Register Gateway with TTN
-bool register_gateway_with_ttn() {
-    // Implementation for gateway registration API call
-    // ...
+// Register Gateway with TTN (create or update its identity and frequency plan)
+bool register_gateway_with_ttn(region_t region) {
+    const char *plan = ttn_frequency_plan(region);
+    if(!plan) return false;
+
+    CURL *curl = curl_easy_init();
+    if(!curl) return false;
+    
+    char *response = NULL;
+    char auth_header[128];
+    char url[256];
+    
+    snprintf(auth_header, sizeof(auth_header), "Authorization: Bearer %s", get_ttn_api_key());
+    snprintf(url, sizeof(url), "%s/gateways/%s", TTN_BASE_URL, get_gateway_id());
+    
+    // {"gateway": {"ids": {...}, "frequency_plan_id": ...}, "field_mask": {"paths": [...]}}
+    cJSON *root = cJSON_CreateObject();
+    cJSON *gateway = cJSON_AddObjectToObject(root, "gateway");
+    cJSON *ids = cJSON_AddObjectToObject(gateway, "ids");
+    cJSON_AddStringToObject(ids, "gateway_id", get_gateway_id());
+    cJSON_AddStringToObject(gateway, "frequency_plan_id", plan);
+    cJSON *mask = cJSON_AddObjectToObject(root, "field_mask");
+    cJSON *paths = cJSON_AddArrayToObject(mask, "paths");
+    cJSON_AddItemToArray(paths, cJSON_CreateString("frequency_plan_id"));
+    
+    char *json_payload = cJSON_PrintUnformatted(root);
+    
+    struct curl_slist *headers = NULL;
+    headers = curl_slist_append(headers, "Content-Type: application/json");
+    headers = curl_slist_append(headers, auth_header);
+    
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PUT");
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_payload);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, curl_write_cb);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, TTN_TIMEOUT_MS);
+    
+    CURLcode res = curl_easy_perform(curl);
+    
+    long status = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+    
+    curl_slist_free_all(headers);
+    curl_easy_cleanup(curl);
+    cJSON_Delete(root);
+    free(json_payload);
+    free(response);
+    
+    if(res != CURLE_OK) {
+        log_error("TTN registration failed: %s", curl_easy_strerror(res));
+        return false;
+    }
+    return status >= 200 && status < 300;
 }
@@ -0,0 +1,61 @@
+#ifndef TTN_INTEGRATION_H
+#define TTN_INTEGRATION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "command_queue.h"
+#include "lora_protocol.h"
+
+#define TTN_COMMAND_FPORT 10          // FPort carrying irrigation_command_t
+#define TTN_STREAM_TIMEOUT_MS 60000   // Long-poll window per stream request
+#define TTN_LINE_MAX 4096             // Longest NDJSON message accepted
+#define TTN_UPLINK_QUEUE_SIZE 32      // Uplinks awaiting the forwarder thread
+#define TTN_UPLINK_MAX 256            // Largest frame the radio hands over
+
+// Incremental NDJSON decoder state for the downlink stream
+typedef struct {
+    char line[TTN_LINE_MAX];
+    size_t len;
+    bool overflow;                    // Discarding an oversized line
+    command_queue_t *queue;
+    uint32_t messages;
+    uint32_t commands;
+    uint32_t malformed;
+    uint32_t unaddressed;             // Command without end_device_ids.dev_addr
+} ttn_stream_t;
+
+// Uplinks handed from the radio loop to the forwarder thread. Queuing
+// never waits on the network; when the forwarder falls behind, the oldest
+// uplink is dropped.
+typedef struct {
+    uint8_t data[TTN_UPLINK_MAX];
+    size_t len;
+} ttn_uplink_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    ttn_uplink_t slots[TTN_UPLINK_QUEUE_SIZE];
+    size_t head;
+    size_t count;
+    uint32_t dropped;                 // Oldest uplink overwritten when full
+} ttn_uplink_queue_t;
+
+// Uplink Forwarding
+bool forward_to_ttn(const uint8_t *packet, size_t len);
+void ttn_uplink_queue_init(ttn_uplink_queue_t *q);
+bool ttn_queue_uplink(ttn_uplink_queue_t *q, const uint8_t *packet, size_t len);
+void ttn_uplink_pop(ttn_uplink_queue_t *q, ttn_uplink_t *out);
+
+// Downlink Ingestion
+void ttn_set_command_queue(command_queue_t *queue);
+void ttn_stream_init(ttn_stream_t *stream, command_queue_t *queue);
+size_t ttn_stream_feed(ttn_stream_t *stream, const char *data, size_t len);
+bool process_ttn_downlinks();
+
+// Gateway Registration
+const char *ttn_frequency_plan(region_t region);
+bool register_gateway_with_ttn(region_t region);
+
+#endif // TTN_INTEGRATION_H
@@ -0,0 +1,380 @@
+#include "tx_scheduler.h"
+#include <string.h>
+
+#define TX_IDLE_WAIT_MS 1000
+#define MAX_DWELL_MS 400          // US915/AU915/AS923 dwell-time limit
+
+typedef struct {
+    uint8_t sf;
+    uint8_t bw_khz_div;           // 1 = 125, 2 = 250, 4 = 500 kHz
+} dr_entry_t;
+
+// Datarate tables per region (sf == 0: undefined)
+static const dr_entry_t dr_eu868[16] = {
+    {12, 1}, {11, 1}, {10, 1}, {9, 1}, {8, 1}, {7, 1}, {7, 2}
+};
+static const dr_entry_t dr_us915[16] = {
+    {10, 1}, {9, 1}, {8, 1}, {7, 1}, {8, 4}, {0, 0}, {0, 0}, {0, 0},
+    {12, 4}, {11, 4}, {10, 4}, {9, 4}, {8, 4}, {7, 4}
+};
+static const dr_entry_t dr_au915[16] = {
+    {12, 1}, {11, 1}, {10, 1}, {9, 1}, {8, 1}, {7, 1}, {8, 4}, {0, 0},
+    {12, 4}, {11, 4}, {10, 4}, {9, 4}, {8, 4}, {7, 4}
+};
+
+// Fixed channels per region (indexed by region_t)
+typedef struct {
+    uint32_t uplink_freq_hz;      // Default channel 0, used for the gateway's own frames
+    uint32_t rx2_freq_hz;
+    uint8_t rx2_dr;
+} region_channels_t;
+
+static const region_channels_t region_channels[] = {
+    [EU868] = { 868100000u, 869525000u, 0 },   // RX2 in the 10 % sub-band
+    [US915] = { 902300000u, 923300000u, 8 },   // Sub-band 1
+    [AS923] = { 923200000u, 923200000u, 2 },
+    [AU915] = { 915200000u, 923300000u, 8 },   // Sub-band 1
+    [IN865] = { 865062500u, 866550000u, 2 },
+};
+
+static const region_channels_t *channels_for(region_t region) {
+    if((unsigned)region >= sizeof(region_channels) / sizeof(region_channels[0])) {
+        return &region_channels[EU868];
+    }
+    return &region_channels[region];
+}
+
+// Wrap-safe millisecond comparison
+static inline bool time_before(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b) < 0;
+}
+
+static inline uint32_t time_max(uint32_t a, uint32_t b) {
+    return time_before(a, b) ? b : a;
+}
+
+// Resolve a datarate index into spreading factor and bandwidth
+bool lora_datarate_params(region_t region, uint8_t dr, uint8_t *sf, uint32_t *bw_hz) {
+    const dr_entry_t *table;
+    switch(region) {
+        case US915: table = dr_us915; break;
+        case AU915: table = dr_au915; break;
+        case EU868:
+        case AS923:
+        case IN865:
+        default: table = dr_eu868; break;
+    }
+
+    if(dr >= 16 || table[dr].sf == 0) return false;
+    *sf = table[dr].sf;
+    *bw_hz = 125000u * table[dr].bw_khz_div;
+    return true;
+}
+
+// Channel the gateway uses for its own (non-downlink) frames
+uint32_t tx_region_default_freq_hz(region_t region) {
+    return channels_for(region)->uplink_freq_hz;
+}
+
+/**
+ * LoRa time-on-air (Semtech AN1200.13), explicit header, CR 4/5, 8 preamble symbols
+ *
+ * @param sf Spreading factor (7-12)
+ * @param bw_hz Bandwidth in Hz
+ * @param payload_len PHYPayload length in bytes
+ * @param crc_on Payload CRC present (uplinks)
+ * @return Airtime in microseconds
+ */
+uint32_t lora_time_on_air_us(uint8_t sf, uint32_t bw_hz, size_t payload_len, bool crc_on) {
+    uint32_t t_sym = (uint32_t)(((uint64_t)1000000u << sf) / bw_hz);
+    bool low_dr_optimize = (t_sym >= 16000);
+
+    int32_t num = 8 * (int32_t)payload_len - 4 * sf + 28 + (crc_on ? 16 : 0);
+    int32_t den = 4 * (sf - (low_dr_optimize ? 2 : 0));
+    int32_t blocks = num > 0 ? (num + den - 1) / den : 0;
+    uint32_t payload_symbols = 8 + (uint32_t)blocks * 5;
+
+    // Preamble: 8 programmed + 4.25 sync symbols
+    return (t_sym * 49) / 4 + payload_symbols * t_sym;
+}
+
+uint32_t tx_time_on_air_ms(region_t region, uint8_t dr, size_t payload_len, bool downlink) {
+    uint8_t sf;
+    uint32_t bw;
+    if(!lora_datarate_params(region, dr, &sf, &bw)) return 0;
+    // Downlinks are sent without payload CRC
+    return (lora_time_on_air_us(sf, bw, payload_len, !downlink) + 999) / 1000;
+}
+
+static void add_band(tx_scheduler_t *s, uint32_t min_hz, uint32_t max_hz, uint16_t duty_inverse) {
+    tx_subband_t *b = &s->bands[s->band_count++];
+    b->min_hz = min_hz;
+    b->max_hz = max_hz;
+    b->duty_inverse = duty_inverse;
+    b->available_at = 0;
+    b->airtime_ms = 0;
+}
+
+static tx_subband_t *find_band(tx_scheduler_t *s, uint32_t freq_hz) {
+    for(int i = 0; i < s->band_count; i++) {
+        if(freq_hz >= s->bands[i].min_hz && freq_hz <= s->bands[i].max_hz) {
+            return &s->bands[i];
+        }
+    }
+    return NULL;
+}
+
+// Initialize Scheduler with the region's sub-band plan
+void tx_scheduler_init(tx_scheduler_t *s, region_t region, tx_send_fn send, void *ctx) {
+    memset(s, 0, sizeof(tx_scheduler_t));
+    s->region = region;
+    s->send = send;
+    s->send_ctx = ctx;
+
+    if(region == EU868) {
+        // ETSI EN 300 220 sub-bands g, g1, g2, g3
+        add_band(s, 863000000, 868600000, 100);
+        add_band(s, 868700000, 869200000, 1000);
+        add_band(s, 869400000, 869650000, 10);
+        add_band(s, 869700000, 870000000, 100);
+    } else {
+        add_band(s, 0, 0xFFFFFFFFu, 0);
+    }
+}
+
+// Report the fate of tagged frames (e.g. to account or requeue their payload)
+void tx_scheduler_set_done_hook(tx_scheduler_t *s, tx_done_fn done, void *ctx) {
+    s->done = done;
+    s->done_ctx = ctx;
+}
+
+static void frame_done(tx_scheduler_t *s, tx_frame_t *f, bool sent, uint32_t air_ms) {
+    f->in_use = 0;
+    if(f->tag != TX_TAG_NONE && s->done) s->done(s->done_ctx, f->tag, sent, air_ms);
+}
+
+static bool window_timestamped(const tx_window_t *w) {
+    return w->tx_at_ms != 0;
+}
+
+// Latest moment the window can still be used
+static uint32_t window_deadline(const tx_window_t *w) {
+    return window_timestamped(w) ? w->tx_at_ms : w->deadline_ms;
+}
+
+static bool frame_airtime(tx_scheduler_t *s, tx_frame_t *f) {
+    // Timestamped frames are RX-window downlinks (no CRC); count ASAP frames conservatively
+    f->airtime_ms = tx_time_on_air_ms(s->region, f->window.dr, f->len,
+                                      window_timestamped(&f->window));
+    if(f->airtime_ms == 0 || !find_band(s, f->window.freq_hz)) return false;
+
+    bool dwell_limited = (s->region == US915 || s->region == AU915 || s->region == AS923);
+    if(dwell_limited && f->airtime_ms > MAX_DWELL_MS) {
+        s->stats.rejected_dwell++;
+        return false;
+    }
+    return true;
+}
+
+// Switch to the fallback window; false if there is none (frame dropped)
+static bool use_fallback(tx_scheduler_t *s, tx_frame_t *f) {
+    while(f->has_fallback) {
+        f->window = f->fallback;
+        f->has_fallback = 0;
+        if(frame_airtime(s, f)) {
+            s->stats.rx2_fallbacks++;
+            return true;
+        }
+    }
+    s->stats.dropped_deadline++;
+    frame_done(s, f, false, 0);
+    return false;
+}
+
+/**
+ * Queue a frame for transmission
+ *
+ * @param s Scheduler
+ * @param data Frame bytes (copied)
+ * @param len Frame length
+ * @param priority TX_PRIO_* (higher wins)
+ * @param window Primary transmit window
+ * @param fallback Optional secondary window (NULL if none)
+ * @param tag Reported through the done hook once accepted, TX_TAG_NONE if untracked
+ * @return False if the queue is full or the frame can never be sent (no done report)
+ */
+bool tx_scheduler_enqueue(tx_scheduler_t *s, const uint8_t *data, size_t len, uint8_t priority,
+                          const tx_window_t *window, const tx_window_t *fallback, uint32_t tag) {
+    if(len > TX_MAX_FRAME) return false;
+
+    tx_frame_t *slot = NULL;
+    for(int i = 0; i < TX_QUEUE_SIZE; i++) {
+        if(!s->queue[i].in_use) {
+            slot = &s->queue[i];
+            break;
+        }
+    }
+    if(!slot) {
+        s->stats.dropped_full++;
+        return false;
+    }
+
+    memcpy(slot->data, data, len);
+    slot->len = len;
+    slot->priority = priority;
+    slot->window = *window;
+    slot->has_fallback = fallback != NULL;
+    slot->tag = TX_TAG_NONE;
+    if(fallback) slot->fallback = *fallback;
+
+    slot->in_use = 1;
+    if(!frame_airtime(s, slot) && !use_fallback(s, slot)) return false;
+    slot->tag = tag;
+    return true;
+}
+
+// Queue a Class A downlink for RX1 with RX2 as fallback
+bool tx_scheduler_enqueue_class_a(tx_scheduler_t *s, const uint8_t *data, size_t len,
+                                  uint8_t priority, const lora_rx_meta_t *uplink,
+                                  uint32_t rx1_delay_ms, uint32_t tag) {
+    const region_channels_t *plan = channels_for(s->region);
+    tx_window_t rx1, rx2;
+    memset(&rx1, 0, sizeof(rx1));
+    memset(&rx2, 0, sizeof(rx2));
+    rx1.tx_at_ms = uplink->timestamp + rx1_delay_ms;
+    rx2.tx_at_ms = rx1.tx_at_ms + 1000;
+    rx2.freq_hz = plan->rx2_freq_hz;
+    rx2.dr = plan->rx2_dr;
+
+    switch(s->region) {
+        case US915: {
+            uint32_t ch = (uplink->freq_hz - plan->uplink_freq_hz) / 200000u;
+            static const uint8_t rx1_dr[5] = {10, 11, 12, 13, 13};
+            rx1.freq_hz = 923300000u + (ch % 8) * 600000u;
+            rx1.dr = rx1_dr[uplink->datarate < 5 ? uplink->datarate : 4];
+            break;
+        }
+        case AU915: {
+            uint32_t ch = (uplink->freq_hz - plan->uplink_freq_hz) / 200000u;
+            static const uint8_t rx1_dr[7] = {8, 9, 10, 11, 12, 13, 13};
+            rx1.freq_hz = 923300000u + (ch % 8) * 600000u;
+            rx1.dr = rx1_dr[uplink->datarate < 7 ? uplink->datarate : 6];
+            break;
+        }
+        default:
+            // EU868, AS923, IN865: RX1 mirrors the uplink channel and DR
+            rx1.freq_hz = uplink->freq_hz;
+            rx1.dr = uplink->datarate;
+            break;
+    }
+
+    return tx_scheduler_enqueue(s, data, len, priority, &rx1, &rx2, tag);
+}
+
+// Earliest start allowed by the window, the sub-band budget and the radio
+static uint32_t earliest_start(tx_scheduler_t *s, const tx_frame_t *f, uint32_t now_ms) {
+    const tx_subband_t *band = find_band(s, f->window.freq_hz);
+    if(window_timestamped(&f->window)) {
+        return time_max(f->window.tx_at_ms, time_max(band->available_at, s->radio_busy_until));
+    }
+    uint32_t start = time_max(now_ms, f->window.not_before_ms);
+    return time_max(start, time_max(band->available_at, s->radio_busy_until));
+}
+
+// A window is usable if its transmission can still start inside it
+static bool window_viable(tx_scheduler_t *s, const tx_frame_t *f, uint32_t now_ms) {
+    uint32_t start = earliest_start(s, f, now_ms);
+    if(window_timestamped(&f->window)) {
+        return start == f->window.tx_at_ms && !time_before(f->window.tx_at_ms, now_ms);
+    }
+    return !time_before(f->window.deadline_ms, start);
+}
+
+// An ASAP frame may not overlap a queued RX-window transmission
+static bool collides_with_reserved(const tx_scheduler_t *s, const tx_frame_t *f,
+                                   uint32_t start, uint32_t end) {
+    for(int i = 0; i < TX_QUEUE_SIZE; i++) {
+        const tx_frame_t *other = &s->queue[i];
+        if(!other->in_use || other == f || !window_timestamped(&other->window)) continue;
+
+        uint32_t o_start = other->window.tx_at_ms;
+        uint32_t o_end = o_start + other->airtime_ms;
+        if(time_before(start, o_end) && time_before(o_start, end)) return true;
+    }
+    return false;
+}
+
+/**
+ * Run one scheduling step
+ *
+ * @param s Scheduler
+ * @param now_ms Current time
+ * @return Milliseconds until the scheduler next needs servicing
+ */
+uint32_t tx_scheduler_service(tx_scheduler_t *s, uint32_t now_ms) {
+    tx_frame_t *best = NULL;
+    uint32_t best_start = 0;
+
+    for(int i = 0; i < TX_QUEUE_SIZE; i++) {
+        tx_frame_t *f = &s->queue[i];
+        if(!f->in_use) continue;
+
+        // Retarget frames whose window closed or no longer fits the duty-cycle budget
+        bool viable = window_viable(s, f, now_ms);
+        while(!viable) {
+            if(time_before(now_ms, window_deadline(&f->window))) s->stats.duty_deferrals++;
+            if(!use_fallback(s, f)) break;
+            viable = window_viable(s, f, now_ms);
+        }
+        if(!viable) continue;
+
+        uint32_t start = earliest_start(s, f, now_ms);
+        bool open = window_timestamped(&f->window)
+            ? !time_before(now_ms, f->window.tx_at_ms - TX_LEAD_MS)
+            : (start == now_ms &&
+               !collides_with_reserved(s, f, now_ms, now_ms + f->airtime_ms));
+        if(!open) continue;
+
+        if(!best || f->priority > best->priority ||
+           (f->priority == best->priority &&
+            time_before(window_deadline(&f->window), window_deadline(&best->window)))) {
+            best = f;
+            best_start = start;
+        }
+    }
+
+    if(best) {
+        uint32_t tx_at = window_timestamped(&best->window) ? best->window.tx_at_ms : 0;
+        if(s->send(s->send_ctx, best->data, best->len, best->window.freq_hz,
+                   best->window.dr, tx_at)) {
+            tx_subband_t *band = find_band(s, best->window.freq_hz);
+            uint32_t off_factor = band->duty_inverse ? band->duty_inverse : 1;
+            band->available_at = best_start + best->airtime_ms * off_factor;
+            band->airtime_ms += best->airtime_ms;
+            s->radio_busy_until = best_start + best->airtime_ms;
+            s->stats.sent++;
+            frame_done(s, best, true, best_start);
+        }
+    }
+
+    // Next event: a window opening, a band freeing up or the radio going idle
+    uint32_t wait = TX_IDLE_WAIT_MS;
+    for(int i = 0; i < TX_QUEUE_SIZE; i++) {
+        tx_frame_t *f = &s->queue[i];
+        if(!f->in_use) continue;
+
+        uint32_t start = earliest_start(s, f, now_ms);
+        if(window_timestamped(&f->window)) start = f->window.tx_at_ms - TX_LEAD_MS;
+        uint32_t delta = time_before(now_ms, start) ? start - now_ms : 1;
+        if(delta < wait) wait = delta;
+    }
+    return wait;
+}
+
+size_t tx_scheduler_pending(const tx_scheduler_t *s) {
+    size_t pending = 0;
+    for(int i = 0; i < TX_QUEUE_SIZE; i++) {
+        if(s->queue[i].in_use) pending++;
+    }
+    return pending;
+}
@@ -0,0 +1,108 @@
+#ifndef TX_SCHEDULER_H
+#define TX_SCHEDULER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "lora_protocol.h"
+
+// Airtime / Duty-Cycle Aware TX Scheduler
+// Frames are queued with a transmit window and a priority. Each call to
+// tx_scheduler_service() sends at most one frame: the highest-priority frame
+// whose window is open, whose sub-band duty-cycle budget allows it and that
+// does not collide with a reserved RX-window transmission.
+
+#define TX_QUEUE_SIZE 32
+#define TX_MAX_FRAME 256
+#define TX_LEAD_MS 40             // Hand timestamped frames to the radio early
+#define TX_MAX_SUBBANDS 4
+
+// LoRaWAN Class A receive delays
+#define RECEIVE_DELAY1_MS 1000
+#define JOIN_ACCEPT_DELAY1_MS 5000
+
+// Frame priorities (higher first)
+#define TX_PRIO_TELEMETRY 1
+#define TX_PRIO_DOWNLINK 4
+#define TX_PRIO_COMMAND 6
+#define TX_PRIO_JOIN_ACCEPT 8
+
+#define TX_TAG_NONE 0         // Frame needs no completion report
+
+// Radio send hook; tx_at_ms == 0 means "now", else a timestamped TX
+typedef bool (*tx_send_fn)(void *ctx, const uint8_t *data, size_t len,
+                           uint32_t freq_hz, uint8_t dr, uint32_t tx_at_ms);
+
+// Completion hook for tagged frames: sent with its on-air start, or dropped
+typedef void (*tx_done_fn)(void *ctx, uint32_t tag, bool sent, uint32_t air_ms);
+
+// Transmit opportunity
+typedef struct {
+    uint32_t freq_hz;
+    uint8_t dr;
+    uint32_t tx_at_ms;        // Timestamped start (RX window), 0 = ASAP
+    uint32_t not_before_ms;   // ASAP frames only
+    uint32_t deadline_ms;     // ASAP frames only
+} tx_window_t;
+
+typedef struct {
+    uint8_t data[TX_MAX_FRAME];
+    size_t len;
+    uint8_t priority;
+    uint8_t in_use;
+    uint8_t has_fallback;
+    uint32_t tag;             // Caller's handle for tx_done_fn, TX_TAG_NONE if untracked
+    tx_window_t window;       // Primary (e.g. RX1)
+    tx_window_t fallback;     // Secondary (e.g. RX2)
+    uint32_t airtime_ms;      // For the active window
+} tx_frame_t;
+
+// Duty-cycle sub-band (ETSI off-time model)
+typedef struct {
+    uint32_t min_hz;
+    uint32_t max_hz;
+    uint16_t duty_inverse;    // 100 = 1 %, 0 = unrestricted
+    uint32_t available_at;    // Band may transmit again from this time
+    uint32_t airtime_ms;      // Lifetime airtime spent in the band
+} tx_subband_t;
+
+typedef struct {
+    uint32_t sent;
+    uint32_t dropped_deadline;
+    uint32_t dropped_full;
+    uint32_t rejected_dwell;
+    uint32_t rx2_fallbacks;
+    uint32_t duty_deferrals;
+} tx_scheduler_stats_t;
+
+typedef struct {
+    region_t region;
+    tx_frame_t queue[TX_QUEUE_SIZE];
+    tx_subband_t bands[TX_MAX_SUBBANDS];
+    uint8_t band_count;
+    uint32_t radio_busy_until;
+    tx_send_fn send;
+    void *send_ctx;
+    tx_done_fn done;
+    void *done_ctx;
+    tx_scheduler_stats_t stats;
+} tx_scheduler_t;
+
+// Airtime
+bool lora_datarate_params(region_t region, uint8_t dr, uint8_t *sf, uint32_t *bw_hz);
+uint32_t lora_time_on_air_us(uint8_t sf, uint32_t bw_hz, size_t payload_len, bool crc_on);
+uint32_t tx_time_on_air_ms(region_t region, uint8_t dr, size_t payload_len, bool downlink);
+uint32_t tx_region_default_freq_hz(region_t region);
+
+// Scheduler API
+void tx_scheduler_init(tx_scheduler_t *s, region_t region, tx_send_fn send, void *ctx);
+void tx_scheduler_set_done_hook(tx_scheduler_t *s, tx_done_fn done, void *ctx);
+bool tx_scheduler_enqueue(tx_scheduler_t *s, const uint8_t *data, size_t len, uint8_t priority,
+                          const tx_window_t *window, const tx_window_t *fallback, uint32_t tag);
+bool tx_scheduler_enqueue_class_a(tx_scheduler_t *s, const uint8_t *data, size_t len,
+                                  uint8_t priority, const lora_rx_meta_t *uplink,
+                                  uint32_t rx1_delay_ms, uint32_t tag);
+uint32_t tx_scheduler_service(tx_scheduler_t *s, uint32_t now_ms);
+size_t tx_scheduler_pending(const tx_scheduler_t *s);
+
+#endif // TX_SCHEDULER_H
@@ -0,0 +1,226 @@
+#include <math.h>
+#include <string.h>
+#include "climate_model.h"
+#include "decision_engine.h"
+
+// Non-finite readings (sensor fault) never match: NaN compares false
+static inline bool moved(float current, float cached, float tolerance) {
+    return !isfinite(current) || !isfinite(cached) || fabsf(current - cached) > tolerance;
+}
+
+static inline bool finite_state(const SystemState *state) {
+    return isfinite(state->temperature) && isfinite(state->humidity) &&
+           isfinite(state->solar_radiation) && isfinite(state->wind_speed) &&
+           isfinite(state->soil_moisture);
+}
+
+static inline void count(decision_engine_t *engine, decision_stage_t stage, bool hit) {
+    if (hit) {
+        engine->stats[stage].hits++;
+    } else {
+        engine->stats[stage].misses++;
+    }
+}
+
+void decision_engine_default_tolerances(decision_tolerances_t *tol) {
+    tol->temperature = 0.25f;
+    tol->humidity = 2.0f;
+    tol->solar_radiation = 15.0f;
+    tol->wind_speed = 0.3f;
+    // Forecast fields only change on refetch, so exact matching costs no
+    // hits and keeps the skip, frost and rain-factor thresholds exact. The
+    // duration stage is a few multiplies; near saturation half a percent of
+    // soil moisture halves the runtime.
+    tol->soil_moisture = 0.0f;
+    tol->precip_prob = 0.0f;
+    tol->temp_min = 0.0f;
+    tol->decision_margin_mm = 1.5f;
+    tol->forecast_max_age_s = 1800;
+    tol->skip_max_age_s = 600;
+}
+
+/**
+ * Initialize the decision engine
+ *
+ * @param engine Engine state
+ * @param tol Input tolerances (NULL for defaults; all zero = exact recomputation)
+ * @param root_depth Plant root depth (m)
+ */
+void decision_engine_init(decision_engine_t *engine, const decision_tolerances_t *tol,
+                          float root_depth) {
+    memset(engine, 0, sizeof(decision_engine_t));
+    if (tol) {
+        engine->tol = *tol;
+    } else {
+        decision_engine_default_tolerances(&engine->tol);
+    }
+    engine->root_depth = root_depth;
+}
+
+// Drop every cached stage (e.g. after recalibration or a crop change)
+void decision_engine_invalidate(decision_engine_t *engine) {
+    engine->deficit_valid = false;
+    engine->skip_valid = false;
+    engine->duration_valid = false;
+}
+
+bool decision_engine_forecast_stale(const decision_engine_t *engine, time_t now) {
+    return !engine->forecast_valid ||
+           now - engine->forecast_time >= (time_t)engine->tol.forecast_max_age_s;
+}
+
+void decision_engine_set_forecast(decision_engine_t *engine, WeatherForecast forecast, time_t now) {
+    engine->forecast = forecast;
+    engine->forecast_time = now;
+    engine->forecast_valid = true;
+    engine->forecast_fetches++;
+}
+
+// A cached deficit is only trusted when it is more than decision_margin_mm
+// away from the deficit that would flip the irrigate decision. The runtime is
+// linear in the deficit, so compare in seconds using the runtime per mm.
+static bool near_threshold(const decision_engine_t *engine, const SystemState *state) {
+    if (engine->frost_water > 0) return false;
+    float duration = irrigation_duration_from_deficit(engine->deficit, state->soil_moisture,
+                                                      engine->forecast, engine->root_depth);
+    float per_mm = irrigation_duration_from_deficit(1.0f, state->soil_moisture,
+                                                    engine->forecast, engine->root_depth);
+    return !isfinite(duration) || !isfinite(per_mm) ||
+           fabsf(duration - MIN_IRRIGATION_SECONDS) < engine->tol.decision_margin_mm * per_mm;
+}
+
+// Stage 1: water deficit from the climate model
+static void update_deficit(decision_engine_t *engine, const SystemState *state, uint8_t *recomputed) {
+    const decision_tolerances_t *tol = &engine->tol;
+    const SystemState *cached = &engine->deficit_inputs;
+
+    bool hit = engine->deficit_valid &&
+               !moved(state->temperature, cached->temperature, tol->temperature) &&
+               !moved(state->humidity, cached->humidity, tol->humidity) &&
+               !moved(state->solar_radiation, cached->solar_radiation, tol->solar_radiation) &&
+               !moved(state->wind_speed, cached->wind_speed, tol->wind_speed) &&
+               !near_threshold(engine, state);
+    count(engine, DECISION_STAGE_DEFICIT, hit);
+    if (hit) return;
+
+    float deficit = calculate_water_deficit(
+        state->temperature,
+        state->humidity,
+        state->solar_radiation,
+        state->wind_speed
+    );
+
+    engine->deficit_inputs = *state;
+    engine->deficit_valid = finite_state(state) && isfinite(deficit);
+    if (deficit != engine->deficit) {
+        engine->deficit = deficit;
+        engine->deficit_version++;
+    }
+    *recomputed |= 1 << DECISION_STAGE_DEFICIT;
+}
+
+// Stage 2: forecast skip rules and frost protection
+static void update_skip(decision_engine_t *engine, time_t now, uint8_t *recomputed) {
+    const decision_tolerances_t *tol = &engine->tol;
+    const WeatherForecast *forecast = &engine->forecast;
+    const WeatherForecast *cached = &engine->skip_inputs;
+
+    bool hit = engine->skip_valid &&
+               now - engine->skip_time < (time_t)tol->skip_max_age_s &&
+               !moved(forecast->precip_prob, cached->precip_prob, tol->precip_prob) &&
+               !moved(forecast->temp_min, cached->temp_min, tol->temp_min);
+    count(engine, DECISION_STAGE_SKIP, hit);
+    if (hit) return;
+
+    engine->skip = should_skip_watering(*forecast);
+    engine->frost_water = get_frost_protection_water(forecast->temp_min);
+    engine->skip_inputs = *forecast;
+    engine->skip_time = now;
+    engine->skip_valid = isfinite(forecast->precip_prob) && isfinite(forecast->temp_min) &&
+                         isfinite(engine->frost_water);
+    *recomputed |= 1 << DECISION_STAGE_SKIP;
+}
+
+// Stage 3: pump runtime from deficit, soil moisture and rain outlook
+static void update_duration(decision_engine_t *engine, const SystemState *state, uint8_t *recomputed) {
+    const decision_tolerances_t *tol = &engine->tol;
+
+    bool hit = engine->duration_valid &&
+               engine->duration_deficit_version == engine->deficit_version &&
+               !moved(state->soil_moisture, engine->duration_soil, tol->soil_moisture) &&
+               !moved(engine->forecast.precip_prob, engine->duration_precip_prob, tol->precip_prob);
+    count(engine, DECISION_STAGE_DURATION, hit);
+    if (hit) return;
+
+    engine->duration = irrigation_duration_from_deficit(engine->deficit, state->soil_moisture,
+                                                        engine->forecast, engine->root_depth);
+    engine->duration_soil = state->soil_moisture;
+    engine->duration_precip_prob = engine->forecast.precip_prob;
+    engine->duration_deficit_version = engine->deficit_version;
+    engine->duration_valid = engine->deficit_valid && isfinite(state->soil_moisture) &&
+                             isfinite(engine->forecast.precip_prob) && isfinite(engine->duration);
+    *recomputed |= 1 << DECISION_STAGE_DURATION;
+}
+
+#ifdef AMIS_DECISION_PARITY_CHECK
+// Compare against the original, fully recomputed pipeline
+static void parity_check(decision_engine_t *engine, const SystemState *state,
+                         const irrigation_decision_t *decision) {
+    bool irrigate = should_irrigate(*state, engine->forecast);
+    float duration = 0;
+    if (irrigate) {
+        duration = calculate_irrigation_duration(*state, engine->forecast, engine->root_depth) +
+                   get_frost_protection_water(engine->forecast.temp_min);
+    }
+
+    engine->parity_checks++;
+    if (irrigate != decision->irrigate) {
+        engine->parity_mismatches++;
+        log_warning("Decision parity mismatch: full=%d incremental=%d", irrigate, decision->irrigate);
+    } else {
+        float error = fabsf(duration - decision->duration);
+        if (error > engine->parity_max_error) engine->parity_max_error = error;
+    }
+}
+#endif
+
+/**
+ * Decide whether and how long to irrigate, rerunning only invalidated stages
+ *
+ * @param engine Engine state (needs a forecast, see decision_engine_set_forecast)
+ * @param state Current sensor readings
+ * @param now Current time
+ * @return Irrigation decision; duration includes frost protection water
+ */
+irrigation_decision_t decision_engine_evaluate(decision_engine_t *engine, const SystemState *state,
+                                               time_t now) {
+    irrigation_decision_t decision = {0};
+    if (!engine->forecast_valid) return decision;
+    engine->evaluations++;
+
+    update_skip(engine, now, &decision.recomputed);
+
+    // Skipped cycles never need the ET model
+    if (!engine->skip) {
+        update_deficit(engine, state, &decision.recomputed);
+        update_duration(engine, state, &decision.recomputed);
+
+        decision.frost_water = engine->frost_water;
+        decision.irrigate = engine->frost_water > 0 || engine->duration > MIN_IRRIGATION_SECONDS;
+        if (decision.irrigate) {
+            decision.duration = engine->duration + engine->frost_water;
+        }
+    }
+
+#ifdef AMIS_DECISION_PARITY_CHECK
+    parity_check(engine, state, &decision);
+#endif
+    return decision;
+}
+
+// Fraction of evaluations served from cache for one stage
+float decision_engine_hit_rate(const decision_engine_t *engine, decision_stage_t stage) {
+    const decision_stage_stats_t *s = &engine->stats[stage];
+    uint32_t total = s->hits + s->misses;
+    return total ? (float)s->hits / total : 0.0f;
+}
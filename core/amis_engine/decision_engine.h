@@ -0,0 +1,107 @@
+#ifndef DECISION_ENGINE_H
+#define DECISION_ENGINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "irrigation_logic.h"
+
+// Incremental Irrigation Decision Engine
+// Memoizes the stages of the irrigation pipeline and reruns a stage only when
+// one of its inputs moved beyond its tolerance since the cached result was
+// computed (not since the last cycle, so slow drift still invalidates):
+//
+//   sensors  --> deficit (calculate_water_deficit) --+
+//                                                    +--> duration --> decision
+//   forecast --> skip / frost (should_skip_watering) +
+//
+// Non-finite inputs or results are never cached.
+//
+// Build with AMIS_DECISION_PARITY_CHECK to run the full pipeline alongside
+// every evaluation and count divergences.
+
+typedef struct {
+    float temperature;          // °C
+    float humidity;             // %
+    float solar_radiation;      // W/m²
+    float wind_speed;           // m/s
+    float soil_moisture;        // % VWC
+    float precip_prob;          // 0-1
+    float temp_min;             // °C
+    float decision_margin_mm;   // mm/day; covers the deficit error the tolerances above allow
+    uint32_t forecast_max_age_s;    // Refetch the forecast after this long
+    uint32_t skip_max_age_s;        // should_skip_watering also depends on time since rain
+} decision_tolerances_t;
+
+typedef enum {
+    DECISION_STAGE_DEFICIT = 0,
+    DECISION_STAGE_SKIP = 1,
+    DECISION_STAGE_DURATION = 2,
+    DECISION_STAGE_COUNT
+} decision_stage_t;
+
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;
+} decision_stage_stats_t;
+
+typedef struct {
+    bool irrigate;
+    float duration;             // Seconds, including frost protection water
+    float frost_water;          // Seconds
+    uint8_t recomputed;         // Bit per decision_stage_t rerun this cycle
+} irrigation_decision_t;
+
+typedef struct {
+    decision_tolerances_t tol;
+    float root_depth;
+
+    // Forecast cache
+    WeatherForecast forecast;
+    time_t forecast_time;
+    bool forecast_valid;
+
+    // Deficit stage
+    SystemState deficit_inputs;
+    float deficit;
+    bool deficit_valid;
+    uint32_t deficit_version;       // Bumped when the cached deficit changes
+
+    // Skip / frost stage
+    WeatherForecast skip_inputs;
+    time_t skip_time;
+    bool skip;
+    float frost_water;
+    bool skip_valid;
+
+    // Duration stage
+    float duration_soil;
+    float duration_precip_prob;
+    uint32_t duration_deficit_version;
+    float duration;
+    bool duration_valid;
+
+    decision_stage_stats_t stats[DECISION_STAGE_COUNT];
+    uint32_t evaluations;
+    uint32_t forecast_fetches;
+
+    // Only updated when built with AMIS_DECISION_PARITY_CHECK
+    uint32_t parity_checks;
+    uint32_t parity_mismatches;     // Irrigate decision differed
+    float parity_max_error;         // Largest duration difference (s)
+} decision_engine_t;
+
+// Engine API
+void decision_engine_default_tolerances(decision_tolerances_t *tol);
+void decision_engine_init(decision_engine_t *engine, const decision_tolerances_t *tol,
+                          float root_depth);
+void decision_engine_invalidate(decision_engine_t *engine);
+bool decision_engine_forecast_stale(const decision_engine_t *engine, time_t now);
+void decision_engine_set_forecast(decision_engine_t *engine, WeatherForecast forecast, time_t now);
+irrigation_decision_t decision_engine_evaluate(decision_engine_t *engine, const SystemState *state,
+                                               time_t now);
+
+// Cache statistics
+float decision_engine_hit_rate(const decision_engine_t *engine, decision_stage_t stage);
+
+#endif // DECISION_ENGINE_H
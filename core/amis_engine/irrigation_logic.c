@@ -1,29 +1,14 @@
 #include <math.h>
 #include <time.h>
 #include "climate_model.h"
+#include "irrigation_logic.h"
+#include "decision_engine.h"
 
 // Sensor calibration parameters
 #define SOIL_MOISTURE_MIN 1200   // Dry soil ADC value
 #define SOIL_MOISTURE_MAX 2800   // Saturated soil ADC value
 #define PUMP_FLOW_RATE 2.5       // ml/sec
 
-// System state structure
-typedef struct {
-    float soil_moisture;       // Current VWC (%)
-    float temperature;          // Ambient temp (°C)
-    float humidity;             // Relative humidity (%)
-    float solar_radiation;      // Light intensity (W/m²)
-    float wind_speed;           // Wind speed (m/s)
-} SystemState;
-
-// Weather forecast structure
-typedef struct {
-    float precip_prob;          // Precipitation probability (0-1)
-    float precip_mm;            // Expected precipitation (mm)
-    float temp_min;             // Minimum temperature (°C)
-    float temp_max;             // Maximum temperature (°C)
-} WeatherForecast;
-
 /**
  * Calculate irrigation duration based on environmental conditions
  * 
@@ -41,8 +26,22 @@ float calculate_irrigation_duration(SystemState state, WeatherForecast forecast,
         state.wind_speed
     );
     
+    return irrigation_duration_from_deficit(water_deficit, state.soil_moisture, forecast, root_depth);
+}
+
+/**
+ * Irrigation duration for an already computed water deficit
+ * 
+ * @param water_deficit Crop water deficit (mm/day)
+ * @param soil_moisture Current VWC (%)
+ * @param forecast Weather forecast data
+ * @param root_depth Plant root depth (m)
+ * @return Watering duration in seconds
+ */
+float irrigation_duration_from_deficit(float water_deficit, float soil_moisture,
+                                       WeatherForecast forecast, float root_depth) {
     // 2. Calculate soil moisture adjustment factor (0-1)
-    float soil_factor = 1.0 - (state.soil_moisture / 100.0);
+    float soil_factor = 1.0 - (soil_moisture / 100.0);
     
     // 3. Calculate root zone volume adjustment
     float root_volume_factor = root_depth * 0.7;  // Assume 70% root density
@@ -83,7 +82,7 @@ bool should_irrigate(SystemState state, WeatherForecast forecast) {
     
     // Standard moisture-based irrigation logic
     float irrigation_duration = calculate_irrigation_duration(state, forecast, ROOT_DEPTH);
-    return (irrigation_duration > 10.0);  // Minimum 10-second runtime
+    return (irrigation_duration > MIN_IRRIGATION_SECONDS);
 }
 
 /**
@@ -103,32 +102,31 @@ float get_frost_protection_water(float min_temp) {
 
 /**
  * Main irrigation control loop
+ * Stages are memoized: the forecast is refetched only when stale and each
+ * stage reruns only when its inputs moved beyond the configured tolerances.
  */
 void irrigation_control_loop() {
+    static decision_engine_t engine;
+    static bool engine_ready = false;
+    if (!engine_ready) {
+        decision_engine_init(&engine, NULL, ROOT_DEPTH);
+        engine_ready = true;
+    }
+    
     SystemState current_state = read_sensors();
-    WeatherForecast forecast = get_weather_forecast();
+    time_t now = time(NULL);
     
-    if (should_irrigate(current_state, forecast)) {
-        float duration = calculate_irrigation_duration(
-            current_state, 
-            forecast, 
-            ROOT_DEPTH
-        );
-        
-        // Add frost protection water if needed
-        float frost_water = get_frost_protection_water(forecast.temp_min);
-        duration += frost_water;
-        
-        // Execute watering
-        activate_irrigation(duration);
+    if (decision_engine_forecast_stale(&engine, now)) {
+        decision_engine_set_forecast(&engine, get_weather_forecast(), now);
+    }
+    
+    irrigation_decision_t decision = decision_engine_evaluate(&engine, &current_state, now);
+    
+    if (decision.irrigate) {
+        // Duration already includes frost protection water
+        activate_irrigation(decision.duration);
         
         // Log irrigation event
-        log_irrigation_event(duration, current_state);
+        log_irrigation_event(decision.duration, current_state);
     }
 }
-
-// Helper Functions (implement in hardware layer)
-SystemState read_sensors();
-WeatherForecast get_weather_forecast();
-void activate_irrigation(float duration_seconds);
-void log_irrigation_event(float duration, SystemState state);
@@ -0,0 +1,39 @@
+#ifndef IRRIGATION_LOGIC_H
+#define IRRIGATION_LOGIC_H
+
+#include <stdbool.h>
+
+// System state structure
+typedef struct {
+    float soil_moisture;       // Current VWC (%)
+    float temperature;          // Ambient temp (°C)
+    float humidity;             // Relative humidity (%)
+    float solar_radiation;      // Light intensity (W/m²)
+    float wind_speed;           // Wind speed (m/s)
+} SystemState;
+
+// Weather forecast structure
+typedef struct {
+    float precip_prob;          // Precipitation probability (0-1)
+    float precip_mm;            // Expected precipitation (mm)
+    float temp_min;             // Minimum temperature (°C)
+    float temp_max;             // Maximum temperature (°C)
+} WeatherForecast;
+
+#define MIN_IRRIGATION_SECONDS 10.0f
+
+// Irrigation decisions
+float calculate_irrigation_duration(SystemState state, WeatherForecast forecast, float root_depth);
+float irrigation_duration_from_deficit(float water_deficit, float soil_moisture,
+                                       WeatherForecast forecast, float root_depth);
+bool should_irrigate(SystemState state, WeatherForecast forecast);
+float get_frost_protection_water(float min_temp);
+void irrigation_control_loop();
+
+// Helper Functions (implement in hardware layer)
+SystemState read_sensors();
+WeatherForecast get_weather_forecast();
+void activate_irrigation(float duration_seconds);
+void log_irrigation_event(float duration, SystemState state);
+
+#endif // IRRIGATION_LOGIC_H
@@ -0,0 +1,337 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include "scenario_batch.h"
+
+// Skip rules (MicroclimateModel.should_skip_watering)
+#define SKIP_PRECIP_PROB 0.4
+#define SKIP_RAIN_PAUSE_HOURS 24.0
+#define SKIP_FREEZE_TEMP 1.0
+#define DEFAULT_TEMP_MIN 10.0
+#define DEFAULT_WIND_SPEED 2.0
+
+static const crop_params_t crop_table[CROP_COUNT] = {
+    [CROP_TOMATO]  = { 1.15f, 0.8f,  5.0f },
+    [CROP_LETTUCE] = { 1.0f,  0.3f,  2.0f },
+    [CROP_CACTUS]  = { 0.3f,  0.5f,  0.0f },
+    [CROP_CITRUS]  = { 0.8f,  1.2f, -2.0f }
+};
+
+struct scenario_pool {
+    pthread_t *workers;
+    int threads;                // Including the calling thread
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_cv;
+    pthread_cond_t done_cv;
+    uint64_t generation;
+    int active;                 // Workers still running the current job
+    bool shutdown;
+
+    const scenario_table_t *table;
+    scenario_result_t *results;
+    atomic_size_t next;         // Next unclaimed chunk start row
+};
+
+const crop_params_t *scenario_crop_params(uint8_t crop) {
+    return crop < CROP_COUNT ? &crop_table[crop] : &crop_table[CROP_LETTUCE];
+}
+
+// Psychrometric constant (kPa/°C) at a given elevation
+static inline double psychrometric_gamma(double elevation) {
+    double atm_pressure = 101.3 * pow((293.0 - 0.0065 * elevation) / 293.0, 5.26);
+    return 0.000665 * atm_pressure;
+}
+
+// FAO Penman-Monteith ETc (mm/day) with a precomputed gamma
+static inline double penman_monteith(double k_c, double gamma, double temp, double rh,
+                                     double solar_rad, double wind_speed) {
+    double rad_mj = solar_rad * 0.0864;
+    double sat_vp = 0.6108 * exp((17.27 * temp) / (temp + 237.3));
+    double act_vp = sat_vp * (rh / 100.0);
+    double delta = 4098.0 * sat_vp / ((temp + 237.3) * (temp + 237.3));
+
+    double numerator = 0.408 * delta * rad_mj +
+                       gamma * (900.0 / (temp + 273.0)) * wind_speed * (sat_vp - act_vp);
+    double denominator = delta + gamma * (1.0 + 0.34 * wind_speed);
+
+    double etc = numerator / denominator * k_c;
+    return etc > 0.0 ? etc : 0.0;
+}
+
+/**
+ * Daily water deficit for one set of conditions
+ * (MicroclimateModel.calculate_water_deficit)
+ *
+ * @param crop Crop profile
+ * @param elevation Elevation (m)
+ * @param temp Temperature (°C)
+ * @param rh Relative humidity (%)
+ * @param solar_rad Solar radiation (W/m²)
+ * @param wind_speed Wind speed at 2 m (m/s)
+ * @return Crop evapotranspiration in mm/day
+ */
+double scenario_water_deficit(const crop_params_t *crop, double elevation, double temp,
+                              double rh, double solar_rad, double wind_speed) {
+    return penman_monteith(crop->k_c, psychrometric_gamma(elevation),
+                           temp, rh, solar_rad, wind_speed);
+}
+
+static void evaluate_row(const scenario_table_t *t, size_t row, scenario_result_t *out) {
+    const crop_params_t *crop = scenario_crop_params(t->crop[row]);
+    double gamma = psychrometric_gamma(t->elevation[row]);
+    size_t base = row * t->hours;
+
+    // Each hourly rate covers 1/24 of a day
+    double etc_sum = 0.0;
+    double peak = 0.0;
+    double temp_min = t->hours ? INFINITY : DEFAULT_TEMP_MIN;
+    for (size_t h = 0; h < t->hours; h++) {
+        double temp = t->temp[base + h];
+        double wind = t->wind ? t->wind[base + h] : DEFAULT_WIND_SPEED;
+        double etc = penman_monteith(crop->k_c, gamma, temp, t->rh[base + h],
+                                     t->solar[base + h], wind);
+        etc_sum += etc;
+        if (etc > peak) peak = etc;
+        if (temp < temp_min) temp_min = temp;
+    }
+
+    // Frost protection: 10 minutes per degree below critical + 2°C
+    double frost = 0.0;
+    if (t->hours && temp_min <= crop->critical_temp + 2.0) {
+        frost = fmax((crop->critical_temp + 2.0 - temp_min) * 10.0, 0.0);
+    }
+
+    bool skip = false;
+    if (t->precip_prob && t->precip_prob[row] > SKIP_PRECIP_PROB) {
+        skip = true;
+    } else if (t->hours_since_rain && t->hours_since_rain[row] < SKIP_RAIN_PAUSE_HOURS) {
+        skip = true;
+    } else if (temp_min < SKIP_FREEZE_TEMP) {
+        skip = true;
+    }
+
+    out->field_id = t->field_id ? t->field_id[row] : (uint32_t)row;
+    out->etc_mm = (float)(etc_sum / 24.0);
+    out->peak_etc_mm_day = (float)peak;
+    out->temp_min = (float)temp_min;
+    out->frost_minutes = (float)frost;
+    out->water_need_mm = skip ? 0.0f : out->etc_mm;
+    out->skip = skip;
+}
+
+void scenario_evaluate_range(const scenario_table_t *table, scenario_result_t *results,
+                             size_t begin, size_t end) {
+    for (size_t row = begin; row < end; row++) {
+        evaluate_row(table, row, &results[row]);
+    }
+}
+
+// Claim chunks until the table is exhausted
+static void run_chunks(scenario_pool_t *pool) {
+    const scenario_table_t *table = pool->table;
+    size_t begin;
+    while ((begin = atomic_fetch_add(&pool->next, SCENARIO_CHUNK_ROWS)) < table->rows) {
+        size_t end = begin + SCENARIO_CHUNK_ROWS;
+        if (end > table->rows) end = table->rows;
+        scenario_evaluate_range(table, pool->results, begin, end);
+    }
+}
+
+static void *pool_worker(void *arg) {
+    scenario_pool_t *pool = arg;
+    uint64_t seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    while (1) {
+        while (pool->generation == seen && !pool->shutdown) {
+            pthread_cond_wait(&pool->work_cv, &pool->lock);
+        }
+        if (pool->shutdown) break;
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        run_chunks(pool);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->active == 0) {
+            pthread_cond_signal(&pool->done_cv);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+/**
+ * Start a persistent evaluation pool
+ *
+ * @param threads Total threads including the caller (<= 0: one per core)
+ * @return Pool handle, NULL on allocation failure
+ */
+scenario_pool_t *scenario_pool_create(int threads) {
+    if (threads <= 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cores > 0 ? (int)cores : 1;
+    }
+
+    scenario_pool_t *pool = calloc(1, sizeof(scenario_pool_t));
+    if (!pool) return NULL;
+    pool->workers = calloc(threads, sizeof(pthread_t));
+    if (!pool->workers) {
+        free(pool);
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_cv, NULL);
+    pthread_cond_init(&pool->done_cv, NULL);
+
+    // The calling thread is worker 0
+    pool->threads = 1;
+    for (int i = 1; i < threads; i++) {
+        if (pthread_create(&pool->workers[i], NULL, pool_worker, pool) != 0) break;
+        pool->threads++;
+    }
+    return pool;
+}
+
+void scenario_pool_destroy(scenario_pool_t *pool) {
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = true;
+    pthread_cond_broadcast(&pool->work_cv);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 1; i < pool->threads; i++) {
+        pthread_join(pool->workers[i], NULL);
+    }
+
+    pthread_cond_destroy(&pool->done_cv);
+    pthread_cond_destroy(&pool->work_cv);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->workers);
+    free(pool);
+}
+
+int scenario_pool_threads(const scenario_pool_t *pool) {
+    return pool->threads;
+}
+
+/**
+ * Evaluate every row of a scenario table
+ *
+ * @param pool Worker pool (one evaluation at a time)
+ * @param table Columnar scenario table
+ * @param results Output array with table->rows entries
+ * @return False if the table is missing a required column
+ */
+bool scenario_pool_evaluate(scenario_pool_t *pool, const scenario_table_t *table,
+                            scenario_result_t *results) {
+    if (!table->elevation || !table->crop) return false;
+    if (table->hours && (!table->temp || !table->rh || !table->solar)) return false;
+    if (table->rows == 0) return true;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->table = table;
+    pool->results = results;
+    atomic_store(&pool->next, 0);
+    pool->active = pool->threads - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work_cv);
+    pthread_mutex_unlock(&pool->lock);
+
+    run_chunks(pool);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->active > 0) {
+        pthread_cond_wait(&pool->done_cv, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return true;
+}
+
+#ifdef SCENARIO_BATCH_BENCH
+// Throughput benchmark:
+//   cc -O2 -DSCENARIO_BATCH_BENCH scenario_batch.c -lpthread -lm -o scenario_bench
+#include <stdio.h>
+#include <time.h>
+
+#define PI 3.14159265358979323846
+
+static double elapsed_s(struct timespec a, struct timespec b) {
+    return (b.tv_sec - a.tv_sec) + (b.tv_nsec - a.tv_nsec) / 1e9;
+}
+
+int main(int argc, char **argv) {
+    size_t rows = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+    size_t hours = argc > 2 ? strtoul(argv[2], NULL, 10) : 72;
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+    uint32_t *field = malloc(rows * sizeof(uint32_t));
+    float *elevation = malloc(rows * sizeof(float));
+    uint8_t *crop = malloc(rows);
+    float *precip = malloc(rows * sizeof(float));
+    float *temp = malloc(rows * hours * sizeof(float));
+    float *rh = malloc(rows * hours * sizeof(float));
+    float *solar = malloc(rows * hours * sizeof(float));
+    float *wind = malloc(rows * hours * sizeof(float));
+    scenario_result_t *results = malloc(rows * sizeof(scenario_result_t));
+    if (!field || !elevation || !crop || !precip || !temp || !rh || !solar || !wind || !results) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    // Synthetic diurnal forecasts
+    srand(42);
+    for (size_t r = 0; r < rows; r++) {
+        field[r] = (uint32_t)(r / CROP_COUNT);
+        elevation[r] = (float)(rand() % 2000);
+        crop[r] = (uint8_t)(r % CROP_COUNT);
+        precip[r] = (float)rand() / RAND_MAX;
+        float base = 5.0f + (float)(rand() % 25);
+        for (size_t h = 0; h < hours; h++) {
+            double phase = sin((h % 24) * (PI / 12.0) - PI / 2.0);
+            size_t i = r * hours + h;
+            temp[i] = base + 6.0f * (float)phase;
+            rh[i] = 60.0f - 20.0f * (float)phase;
+            solar[i] = phase > 0 ? 900.0f * (float)phase : 0.0f;
+            wind[i] = 1.0f + (float)(rand() % 40) / 10.0f;
+        }
+    }
+
+    scenario_table_t table = {
+        .rows = rows, .hours = hours,
+        .field_id = field, .elevation = elevation, .crop = crop,
+        .temp = temp, .rh = rh, .solar = solar, .wind = wind,
+        .precip_prob = precip
+    };
+
+    printf("rows=%zu hours=%zu cores=%ld\n", rows, hours, cores);
+    printf("threads,seconds,rows_per_s,speedup\n");
+
+    double single = 0.0;
+    for (int threads = 1; ; threads = threads * 2 < cores ? threads * 2 : (int)cores) {
+        scenario_pool_t *pool = scenario_pool_create(threads);
+        scenario_pool_evaluate(pool, &table, results);    // Warm-up
+
+        struct timespec t0, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        scenario_pool_evaluate(pool, &table, results);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+
+        double s = elapsed_s(t0, t1);
+        if (threads == 1) single = s;
+        printf("%d,%.4f,%.0f,%.2f\n", scenario_pool_threads(pool), s, rows / s, single / s);
+        scenario_pool_destroy(pool);
+        if (threads >= cores) break;
+    }
+
+    free(field); free(elevation); free(crop); free(precip);
+    free(temp); free(rh); free(solar); free(wind); free(results);
+    return 0;
+}
+#endif // SCENARIO_BATCH_BENCH
@@ -0,0 +1,78 @@
+#ifndef SCENARIO_BATCH_H
+#define SCENARIO_BATCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Batch Crop Scenario Evaluator
+// Native counterpart of MicroclimateModel (climate_model.py) for what-if
+// runs over many fields x crops x forecasts. Rows are independent, so a
+// persistent worker pool splits the table into chunks and scales with cores.
+
+#define SCENARIO_CHUNK_ROWS 64
+
+// Crop profiles (MicroclimateModel.set_crop_type)
+typedef enum {
+    CROP_TOMATO = 0,
+    CROP_LETTUCE = 1,
+    CROP_CACTUS = 2,
+    CROP_CITRUS = 3,
+    CROP_COUNT
+} crop_type_t;
+
+typedef struct {
+    float k_c;                  // Crop coefficient
+    float root_depth;           // m
+    float critical_temp;        // °C
+} crop_params_t;
+
+// Columnar scenario table: per-row columns have `rows` entries, hourly
+// columns are row-major with `hours` entries per row
+typedef struct {
+    size_t rows;
+    size_t hours;
+
+    const uint32_t *field_id;
+    const float *elevation;     // m
+    const uint8_t *crop;        // crop_type_t; unknown values fall back to lettuce
+
+    const float *temp;          // °C
+    const float *rh;            // %
+    const float *solar;         // W/m²
+    const float *wind;          // m/s at 2 m; NULL = 2.0
+
+    const float *precip_prob;   // Per row, 0-1; NULL = no rain forecast
+    const float *hours_since_rain;  // Per row; NULL = no recent rain
+} scenario_table_t;
+
+// Water-need projection for one row
+typedef struct {
+    uint32_t field_id;
+    float etc_mm;               // Crop ET over the horizon (mm)
+    float peak_etc_mm_day;      // Highest hourly ETc rate (mm/day)
+    float temp_min;             // °C
+    float frost_minutes;        // frost_risk_adjustment()
+    float water_need_mm;        // etc_mm, or 0 when watering is skipped
+    bool skip;                  // should_skip_watering()
+} scenario_result_t;
+
+typedef struct scenario_pool scenario_pool_t;
+
+// Crop Model
+const crop_params_t *scenario_crop_params(uint8_t crop);
+double scenario_water_deficit(const crop_params_t *crop, double elevation, double temp,
+                              double rh, double solar_rad, double wind_speed);
+
+// Evaluate rows [begin, end) on the calling thread
+void scenario_evaluate_range(const scenario_table_t *table, scenario_result_t *results,
+                             size_t begin, size_t end);
+
+// Worker Pool
+scenario_pool_t *scenario_pool_create(int threads);
+void scenario_pool_destroy(scenario_pool_t *pool);
+int scenario_pool_threads(const scenario_pool_t *pool);
+bool scenario_pool_evaluate(scenario_pool_t *pool, const scenario_table_t *table,
+                            scenario_result_t *results);
+
+#endif // SCENARIO_BATCH_H
@@ -0,0 +1,16 @@
+#ifndef CLIMATE_MODEL_H
+#define CLIMATE_MODEL_H
+
+#include "irrigation_logic.h"
+
+// Host-test stand-in for the climate model interface; the tests define the
+// two model functions themselves (see MicroclimateModel in climate_model.py)
+
+#define ROOT_DEPTH 0.8f             // m, tomato
+#define FROST_THRESHOLD 2.0f        // °C
+
+float calculate_water_deficit(float temp, float rh, float solar_rad, float wind_speed);
+bool should_skip_watering(WeatherForecast forecast);
+void log_warning(const char *fmt, ...);
+
+#endif // CLIMATE_MODEL_H
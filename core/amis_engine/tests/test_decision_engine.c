@@ -0,0 +1,335 @@
+// Parity tests: the incremental decision engine with zero tolerances must
+// decide exactly like the full pipeline (should_irrigate and
+// calculate_irrigation_duration plus frost protection water); with the
+// default tolerances it must make the same decisions within a bounded runtime
+//   cc -I. -I.. test_decision_engine.c ../decision_engine.c ../irrigation_logic.c -lm -o test_decision_engine
+
+#include "climate_model.h"
+#include "decision_engine.h"
+#include <math.h>
+#include <stdio.h>
+
+#define CYCLES 200000
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+// Climate model: FAO Penman-Monteith as in MicroclimateModel (tomato, 16 m)
+float calculate_water_deficit(float temp, float rh, float solar_rad, float wind_speed) {
+    double rad_mj = solar_rad * 0.0864;
+    double sat_vp = 0.6108 * exp((17.27 * temp) / (temp + 237.3));
+    double act_vp = sat_vp * (rh / 100.0);
+    double delta = 4098 * sat_vp / pow(temp + 237.3, 2);
+    double gamma = 0.000665 * 101.3 * pow((293 - 0.0065 * 16) / 293, 5.26);
+    double et0 = (0.408 * delta * rad_mj + gamma * (900 / (temp + 273)) * wind_speed * (sat_vp - act_vp)) /
+                 (delta + gamma * (1 + 0.34 * wind_speed));
+    double etc = et0 * 1.15;
+    return etc > 0 ? (float)etc : 0.0f;
+}
+
+bool should_skip_watering(WeatherForecast forecast) {
+    return forecast.precip_prob > 0.4f || forecast.temp_min < 1.0f;
+}
+
+void log_warning(const char *fmt, ...) {
+    (void)fmt;
+}
+
+// Hardware layer is not used by the engine
+SystemState read_sensors() {
+    SystemState state = {0};
+    return state;
+}
+
+WeatherForecast get_weather_forecast() {
+    WeatherForecast forecast = {0};
+    return forecast;
+}
+
+void activate_irrigation(float duration_seconds) {
+    (void)duration_seconds;
+}
+
+void log_irrigation_event(float duration, SystemState state) {
+    (void)duration;
+    (void)state;
+}
+
+static uint32_t rng_state = 1;
+
+static float uniform(float lo, float hi) {
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return lo + (hi - lo) * (float)(rng_state >> 8) / (float)(1u << 24);
+}
+
+static float drift(float value, float step, float lo, float hi) {
+    value += uniform(-step, step);
+    return value < lo ? lo : value > hi ? hi : value;
+}
+
+static bool chance(float p) {
+    return uniform(0.0f, 1.0f) < p;
+}
+
+// Inputs span skip, frost (temp_min between 1 and 2 °C), rain outlook and
+// soil moisture around the minimum-duration threshold
+static WeatherForecast random_forecast(void) {
+    WeatherForecast forecast;
+    forecast.precip_prob = uniform(0.0f, 0.6f);
+    forecast.precip_mm = uniform(0.0f, 10.0f);
+    forecast.temp_min = uniform(-1.0f, 8.0f);
+    forecast.temp_max = forecast.temp_min + uniform(5.0f, 20.0f);
+    return forecast;
+}
+
+static void random_state(SystemState *state) {
+    state->soil_moisture = chance(0.1f) ? uniform(99.0f, 100.0f) : uniform(10.0f, 100.0f);
+    state->temperature = uniform(-2.0f, 40.0f);
+    state->humidity = uniform(10.0f, 100.0f);
+    state->solar_radiation = chance(0.2f) ? 0.0f : uniform(0.0f, 1000.0f);
+    state->wind_speed = uniform(0.0f, 6.0f);
+}
+
+// Full pipeline decision for the same inputs
+static irrigation_decision_t full_pipeline(const SystemState *state, WeatherForecast forecast) {
+    irrigation_decision_t decision = {0};
+    decision.irrigate = should_irrigate(*state, forecast);
+    if (decision.irrigate) {
+        decision.duration = calculate_irrigation_duration(*state, forecast, ROOT_DEPTH) +
+                            get_frost_protection_water(forecast.temp_min);
+    }
+    return decision;
+}
+
+static void run_parity(float change_prob, uint32_t *irrigated, float *deficit_hit_rate) {
+    decision_tolerances_t tol = {0};
+    decision_engine_t engine;
+    SystemState state;
+    WeatherForecast forecast = random_forecast();
+    time_t now = 1000000;
+
+    decision_engine_init(&engine, &tol, ROOT_DEPTH);
+    random_state(&state);
+
+    for (uint32_t i = 0; i < CYCLES; i++, now += 60) {
+        // Zero forecast age: stale on every cycle
+        CHECK(decision_engine_forecast_stale(&engine, now));
+        if (chance(change_prob)) forecast = random_forecast();
+        decision_engine_set_forecast(&engine, forecast, now);
+
+        // Inputs change one at a time, so every stage sees both hits and misses
+        if (chance(change_prob)) {
+            SystemState next;
+            random_state(&next);
+            switch (i % 5) {
+            case 0: state.soil_moisture = next.soil_moisture; break;
+            case 1: state.temperature = next.temperature; break;
+            case 2: state.humidity = next.humidity; break;
+            case 3: state.solar_radiation = next.solar_radiation; break;
+            default: state.wind_speed = next.wind_speed; break;
+            }
+        }
+        if (i % 1000 == 999) decision_engine_invalidate(&engine);
+
+        irrigation_decision_t got = decision_engine_evaluate(&engine, &state, now);
+        irrigation_decision_t want = full_pipeline(&state, forecast);
+
+        CHECK(got.irrigate == want.irrigate);
+        CHECK(got.duration == want.duration);
+        if (got.irrigate != want.irrigate || got.duration != want.duration) {
+            printf("  cycle %u: engine %d %.3f s, full %d %.3f s\n", i,
+                   got.irrigate, got.duration, want.irrigate, want.duration);
+            return;
+        }
+        if (got.irrigate) (*irrigated)++;
+    }
+    *deficit_hit_rate = decision_engine_hit_rate(&engine, DECISION_STAGE_DEFICIT);
+}
+
+// New forecast and one changed sensor input every cycle
+static void test_parity_fresh_inputs(void) {
+    uint32_t irrigated = 0;
+    float hit_rate = 0;
+    run_parity(1.0f, &irrigated, &hit_rate);
+    CHECK(irrigated > CYCLES / 10);
+    CHECK(irrigated < CYCLES - CYCLES / 10);
+}
+
+// Mostly repeated inputs: exact matches are served from cache and must agree
+static void test_parity_cached_inputs(void) {
+    uint32_t irrigated = 0;
+    float hit_rate = 0;
+    run_parity(0.3f, &irrigated, &hit_rate);
+    CHECK(irrigated > 0);
+    CHECK(hit_rate > 0.5f);
+}
+
+// Default tolerances on slowly drifting sensors, forecast refetched when
+// stale: cached stages may shift the runtime but never the decision
+static void test_default_tolerances(void) {
+    decision_tolerances_t tol;
+    decision_engine_t engine;
+    SystemState state;
+    WeatherForecast forecast = random_forecast();
+    time_t now = 1000000;
+    uint32_t flips = 0, irrigated = 0, beyond_margin = 0;
+    double total_error = 0, total_duration = 0;
+
+    decision_engine_default_tolerances(&tol);
+    decision_engine_init(&engine, &tol, ROOT_DEPTH);
+    random_state(&state);
+
+    for (uint32_t i = 0; i < CYCLES; i++, now += 60) {
+        if (decision_engine_forecast_stale(&engine, now)) {
+            forecast.precip_prob = drift(forecast.precip_prob, 0.05f, 0.0f, 0.6f);
+            forecast.temp_min = drift(forecast.temp_min, 0.5f, -1.0f, 8.0f);
+            decision_engine_set_forecast(&engine, forecast, now);
+        }
+        state.soil_moisture = drift(state.soil_moisture, 0.3f, 10.0f, 100.0f);
+        state.temperature = drift(state.temperature, 0.1f, -2.0f, 40.0f);
+        state.humidity = drift(state.humidity, 0.8f, 10.0f, 100.0f);
+        state.solar_radiation = drift(state.solar_radiation, 8.0f, 0.0f, 1000.0f);
+        state.wind_speed = drift(state.wind_speed, 0.1f, 0.0f, 6.0f);
+
+        irrigation_decision_t got = decision_engine_evaluate(&engine, &state, now);
+        irrigation_decision_t want = full_pipeline(&state, forecast);
+
+        if (got.irrigate != want.irrigate) {
+            flips++;
+        } else if (got.irrigate) {
+            // The cached deficit is off by less than the margin
+            float error = fabsf(got.duration - want.duration);
+            float per_mm = irrigation_duration_from_deficit(1.0f, state.soil_moisture, forecast,
+                                                            ROOT_DEPTH);
+            if (error > tol.decision_margin_mm * per_mm) beyond_margin++;
+            total_error += error;
+            total_duration += want.duration;
+            irrigated++;
+        }
+    }
+
+    CHECK(flips == 0);
+    CHECK(irrigated > CYCLES / 10);
+    CHECK(beyond_margin == 0);
+    CHECK(total_error < 0.02 * total_duration);
+    CHECK(decision_engine_hit_rate(&engine, DECISION_STAGE_DEFICIT) > 0.5f);
+    CHECK(decision_engine_hit_rate(&engine, DECISION_STAGE_SKIP) > 0.5f);
+}
+
+// Cached skip result: served until skip_max_age_s, then rechecked
+static void test_skip_cache_hit(void) {
+    decision_engine_t engine;
+    SystemState state = { 40.0f, 25.0f, 50.0f, 600.0f, 2.0f };
+    WeatherForecast rain = { 0.8f, 12.0f, 6.0f, 18.0f };
+    WeatherForecast frost = { 0.1f, 0.0f, 1.5f, 12.0f };
+
+    decision_engine_init(&engine, NULL, ROOT_DEPTH);
+    decision_engine_set_forecast(&engine, rain, 0);
+    irrigation_decision_t d = decision_engine_evaluate(&engine, &state, 0);
+    CHECK(!d.irrigate && (d.recomputed & (1 << DECISION_STAGE_SKIP)));
+
+    d = decision_engine_evaluate(&engine, &state, 300);
+    CHECK(!d.irrigate && d.recomputed == 0);
+    CHECK(engine.stats[DECISION_STAGE_SKIP].hits == 1);
+
+    d = decision_engine_evaluate(&engine, &state, 600);
+    CHECK(!d.irrigate && (d.recomputed & (1 << DECISION_STAGE_SKIP)));
+
+    // A hit still hands out the cached frost protection water
+    decision_engine_set_forecast(&engine, frost, 660);
+    d = decision_engine_evaluate(&engine, &state, 660);
+    CHECK(d.recomputed & (1 << DECISION_STAGE_SKIP));
+    d = decision_engine_evaluate(&engine, &state, 720);
+    CHECK(!(d.recomputed & (1 << DECISION_STAGE_SKIP)));
+    CHECK(d.irrigate == should_irrigate(state, frost));
+    CHECK(d.frost_water == get_frost_protection_water(frost.temp_min));
+    CHECK(d.duration == calculate_irrigation_duration(state, frost, ROOT_DEPTH) + d.frost_water);
+}
+
+// A faulted sensor reads NaN: it never matches the cache and is never cached
+static void test_nan_inputs(void) {
+    decision_engine_t engine;
+    SystemState state = { 40.0f, 25.0f, 50.0f, 600.0f, 2.0f };
+    SystemState faulted = state;
+    WeatherForecast forecast = { 0.1f, 0.0f, 8.0f, 24.0f };
+    irrigation_decision_t d;
+
+    decision_engine_init(&engine, NULL, ROOT_DEPTH);
+    decision_engine_set_forecast(&engine, forecast, 0);
+    irrigation_decision_t good = decision_engine_evaluate(&engine, &state, 0);
+    CHECK(good.irrigate);
+
+    faulted.temperature = NAN;
+    for (int i = 1; i <= 2; i++) {
+        d = decision_engine_evaluate(&engine, &faulted, i * 60);
+        CHECK(d.recomputed & (1 << DECISION_STAGE_DEFICIT));
+        CHECK(d.irrigate == should_irrigate(faulted, forecast));
+    }
+    d = decision_engine_evaluate(&engine, &state, 180);
+    CHECK(d.recomputed & (1 << DECISION_STAGE_DEFICIT));
+    CHECK(d.irrigate == good.irrigate && d.duration == good.duration);
+
+    faulted = state;
+    faulted.soil_moisture = NAN;
+    for (int i = 4; i <= 5; i++) {
+        d = decision_engine_evaluate(&engine, &faulted, i * 60);
+        CHECK(d.recomputed & (1 << DECISION_STAGE_DURATION));
+        CHECK(d.irrigate == should_irrigate(faulted, forecast));
+    }
+    d = decision_engine_evaluate(&engine, &state, 360);
+    CHECK(d.recomputed & (1 << DECISION_STAGE_DURATION));
+    CHECK(d.irrigate == good.irrigate && d.duration == good.duration);
+
+    // Forecast fields too
+    forecast.precip_prob = NAN;
+    decision_engine_set_forecast(&engine, forecast, 420);
+    for (int i = 7; i <= 8; i++) {
+        d = decision_engine_evaluate(&engine, &state, i * 60);
+        CHECK(d.recomputed & (1 << DECISION_STAGE_SKIP));
+        CHECK(d.irrigate == should_irrigate(state, forecast));
+    }
+}
+
+// Rain skip, and frost protection water with saturated soil
+static void test_skip_and_frost(void) {
+    decision_tolerances_t tol = {0};
+    decision_engine_t engine;
+    SystemState state = { 100.0f, 20.0f, 60.0f, 0.0f, 1.0f };
+    WeatherForecast rain = { 0.8f, 12.0f, 6.0f, 18.0f };
+    WeatherForecast frost = { 0.1f, 0.0f, 1.5f, 12.0f };
+
+    decision_engine_init(&engine, &tol, ROOT_DEPTH);
+
+    decision_engine_set_forecast(&engine, rain, 0);
+    irrigation_decision_t d = decision_engine_evaluate(&engine, &state, 0);
+    CHECK(!d.irrigate && !should_irrigate(state, rain));
+
+    // Saturated soil: only frost protection water is due
+    decision_engine_set_forecast(&engine, frost, 60);
+    d = decision_engine_evaluate(&engine, &state, 60);
+    CHECK(d.irrigate && should_irrigate(state, frost));
+    CHECK(d.frost_water == get_frost_protection_water(frost.temp_min));
+    CHECK(d.duration == calculate_irrigation_duration(state, frost, ROOT_DEPTH) + d.frost_water);
+}
+
+int main(void) {
+    test_parity_fresh_inputs();
+    test_parity_cached_inputs();
+    test_skip_and_frost();
+    test_default_tolerances();
+    test_skip_cache_hit();
+    test_nan_inputs();
+
+    if (failures) {
+        printf("decision_engine: %d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("decision_engine: all tests passed\n");
+    return 0;
+}
@@ -6,4 +6,7 @@
 uint8_t bme280_init();
 void bme280_read_data(float *temp, float *hum, float *pres);
 
+// Convert a raw 0xF7..0xFE burst using the trimming data loaded by bme280_init()
+void bme280_compensate(const uint8_t *raw, float *temp, float *hum, float *pres);
+
 #endif
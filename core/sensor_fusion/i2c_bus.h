@@ -0,0 +1,35 @@
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Bus status codes
+#define I2C_OK 0
+#define I2C_NACK 1
+#define I2C_TIMEOUT 2
+#define I2C_BUS_ERROR 3
+
+// I2C Bus Abstraction
+// A single combined transaction: write tx_len bytes, then (repeated start)
+// read rx_len bytes. Either length may be zero.
+typedef struct {
+    int (*transfer)(void *ctx, uint8_t addr,
+                    const uint8_t *tx, size_t tx_len,
+                    uint8_t *rx, size_t rx_len);
+    uint32_t (*millis)(void *ctx);
+    void (*sleep_until)(void *ctx, uint32_t wake_ms);   // Light sleep / idle
+    void *ctx;
+} i2c_bus_t;
+
+static inline int i2c_write(const i2c_bus_t *bus, uint8_t addr,
+                            const uint8_t *data, size_t len) {
+    return bus->transfer(bus->ctx, addr, data, len, NULL, 0);
+}
+
+static inline int i2c_read_reg(const i2c_bus_t *bus, uint8_t addr, uint8_t reg,
+                               uint8_t *data, size_t len) {
+    return bus->transfer(bus->ctx, addr, &reg, 1, data, len);
+}
+
+#endif
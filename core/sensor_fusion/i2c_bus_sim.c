@@ -0,0 +1,110 @@
+#include "i2c_bus_sim.h"
+#include "sensor_acquisition.h"
+#include <string.h>
+
+#define ADS1115_REG_CONFIG 0x01
+
+static i2c_sim_device_t *find_device(i2c_sim_t *sim, uint8_t addr) {
+    for(int i = 0; i < sim->device_count; i++) {
+        if(sim->devices[i].addr == addr) return &sim->devices[i];
+    }
+    return NULL;
+}
+
+static int sim_transfer(void *ctx, uint8_t addr,
+                        const uint8_t *tx, size_t tx_len,
+                        uint8_t *rx, size_t rx_len) {
+    i2c_sim_t *sim = (i2c_sim_t *)ctx;
+    sim->transactions++;
+    sim->now_ms += sim->transfer_cost_ms;
+
+    i2c_sim_device_t *dev = find_device(sim, addr);
+    if(!dev) {
+        sim->errors++;
+        return I2C_NACK;
+    }
+
+    if(dev->nack_next > 0) {
+        dev->nack_next--;
+        sim->errors++;
+        return dev->fail_code;
+    }
+
+    // Pure write: treat as a conversion trigger
+    if(rx_len == 0) {
+        dev->ready_at = sim->now_ms + dev->conversion_ms;
+        return I2C_OK;
+    }
+
+    // ADS1115 config read reports the OS (conversion idle) bit
+    if(addr == ACQ_ADS1115_ADDR && tx_len == 1 && tx[0] == ADS1115_REG_CONFIG) {
+        bool idle = (int32_t)(sim->now_ms - dev->ready_at) >= 0;
+        memset(rx, 0, rx_len);
+        rx[0] = idle ? 0x80 : 0x00;
+        return I2C_OK;
+    }
+
+    // Data read before the conversion finished is an engine bug
+    if((int32_t)(sim->now_ms - dev->ready_at) < 0) {
+        sim->errors++;
+        return I2C_BUS_ERROR;
+    }
+
+    size_t n = rx_len < dev->data_len ? rx_len : dev->data_len;
+    memset(rx, 0, rx_len);
+    memcpy(rx, dev->data, n);
+    return I2C_OK;
+}
+
+static uint32_t sim_millis(void *ctx) {
+    return ((i2c_sim_t *)ctx)->now_ms;
+}
+
+static void sim_sleep_until(void *ctx, uint32_t wake_ms) {
+    i2c_sim_t *sim = (i2c_sim_t *)ctx;
+    if((int32_t)(wake_ms - sim->now_ms) > 0) {
+        sim->slept_ms += wake_ms - sim->now_ms;
+        sim->now_ms = wake_ms;
+    }
+}
+
+// Initialize simulated bus and bind it to an i2c_bus_t
+void i2c_sim_init(i2c_sim_t *sim, i2c_bus_t *bus) {
+    memset(sim, 0, sizeof(i2c_sim_t));
+    bus->transfer = sim_transfer;
+    bus->millis = sim_millis;
+    bus->sleep_until = sim_sleep_until;
+    bus->ctx = sim;
+}
+
+i2c_sim_device_t *i2c_sim_add_device(i2c_sim_t *sim, uint8_t addr, uint32_t conversion_ms) {
+    if(sim->device_count >= I2C_SIM_MAX_DEVICES) return NULL;
+
+    i2c_sim_device_t *dev = &sim->devices[sim->device_count++];
+    memset(dev, 0, sizeof(i2c_sim_device_t));
+    dev->addr = addr;
+    dev->conversion_ms = conversion_ms;
+    return dev;
+}
+
+void i2c_sim_set_data(i2c_sim_device_t *dev, const uint8_t *data, uint8_t len) {
+    if(len > sizeof(dev->data)) len = sizeof(dev->data);
+    memcpy(dev->data, data, len);
+    dev->data_len = len;
+}
+
+void i2c_sim_inject_errors(i2c_sim_device_t *dev, uint8_t count, int fail_code) {
+    dev->nack_next = count;
+    dev->fail_code = fail_code;
+}
+
+// Typical conversion times: BME280 forced x1, BH1750 H-res, ADS1115 @128 SPS
+void i2c_sim_add_default_sensors(i2c_sim_t *sim) {
+    const uint8_t bme_raw[8] = {0x65, 0x5A, 0xC0, 0x7E, 0xED, 0x00, 0x6B, 0x3E};
+    const uint8_t lux_raw[2] = {0x03, 0xE8};     // 1000 counts -> 833 lx
+    const uint8_t adc_raw[2] = {0x08, 0x34};     // 2100 counts
+
+    i2c_sim_set_data(i2c_sim_add_device(sim, ACQ_BME280_ADDR, 8), bme_raw, 8);
+    i2c_sim_set_data(i2c_sim_add_device(sim, ACQ_BH1750_ADDR, 120), lux_raw, 2);
+    i2c_sim_set_data(i2c_sim_add_device(sim, ACQ_ADS1115_ADDR, 8), adc_raw, 2);
+}
@@ -0,0 +1,42 @@
+#ifndef I2C_BUS_SIM_H
+#define I2C_BUS_SIM_H
+
+#include <stdint.h>
+#include "i2c_bus.h"
+
+// Simulated host backend for i2c_bus_t
+// Models BME280/BH1750/ADS1115 conversion latency on a virtual clock so the
+// acquisition engine can be exercised off-target.
+
+#define I2C_SIM_MAX_DEVICES 4
+
+typedef struct {
+    uint8_t addr;
+    uint32_t conversion_ms;   // Time from trigger to valid data
+    uint32_t ready_at;        // Virtual time the current conversion finishes
+    uint8_t data[8];          // Bytes returned for a data read
+    uint8_t data_len;
+    uint8_t nack_next;        // Fail this many upcoming transactions
+    int fail_code;            // I2C_* code returned while nack_next > 0
+} i2c_sim_device_t;
+
+typedef struct {
+    i2c_sim_device_t devices[I2C_SIM_MAX_DEVICES];
+    int device_count;
+    uint32_t now_ms;
+    uint32_t transfer_cost_ms;   // Virtual time charged per transaction
+    uint32_t slept_ms;           // Accumulated sleep_until() time
+    uint32_t transactions;
+    uint32_t errors;
+} i2c_sim_t;
+
+// Backend API
+void i2c_sim_init(i2c_sim_t *sim, i2c_bus_t *bus);
+i2c_sim_device_t *i2c_sim_add_device(i2c_sim_t *sim, uint8_t addr, uint32_t conversion_ms);
+void i2c_sim_set_data(i2c_sim_device_t *dev, const uint8_t *data, uint8_t len);
+void i2c_sim_inject_errors(i2c_sim_device_t *dev, uint8_t count, int fail_code);
+
+// Populate BME280, BH1750 and ADS1115 with datasheet conversion times
+void i2c_sim_add_default_sensors(i2c_sim_t *sim);
+
+#endif
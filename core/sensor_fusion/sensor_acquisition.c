@@ -0,0 +1,266 @@
+#include "sensor_acquisition.h"
+#include "bme280_driver.h"
+#include <string.h>
+
+// BME280: forced mode, x1 oversampling on T/P/H (datasheet 9.3 ms max)
+#define BME280_REG_CTRL_HUM 0xF2
+#define BME280_REG_CTRL_MEAS 0xF4
+#define BME280_REG_DATA 0xF7
+#define BME280_CTRL_HUM_X1 0x01
+#define BME280_CTRL_MEAS_FORCED_X1 0x25
+#define BME280_CONV_MS 10
+
+// BH1750: one-time high resolution mode, powers down after conversion
+#define BH1750_ONE_TIME_H_RES 0x20
+#define BH1750_CONV_MS 180        // 120 ms typical, 180 ms max
+#define BH1750_LUX_DIVISOR 1.2f
+
+// ADS1115: single-shot AIN0 vs GND, ±4.096 V, 128 SPS
+#define ADS1115_REG_CONVERSION 0x00
+#define ADS1115_REG_CONFIG 0x01
+#define ADS1115_CONFIG_SINGLE_AIN0 0xC383
+#define ADS1115_OS_IDLE 0x8000
+#define ADS1115_CONV_MS 9
+
+#define ACQ_RETRY_DELAY_MS 2
+#define ACQ_NOT_READY_DELAY_MS 1
+
+typedef enum {
+    STEP_OK = 0,
+    STEP_NOT_READY,
+    STEP_ERROR
+} step_result_t;
+
+static const uint32_t conversion_ms[ACQ_CH_COUNT] = {
+    BME280_CONV_MS, BH1750_CONV_MS, ADS1115_CONV_MS
+};
+
+// Time comparison that survives millis() wrap-around
+static inline bool time_reached(uint32_t now, uint32_t deadline) {
+    return (int32_t)(now - deadline) >= 0;
+}
+
+// Issue the conversion command for a channel
+static int trigger_channel(const i2c_bus_t *bus, acq_channel_id_t id) {
+    switch(id) {
+        case ACQ_CH_BME280: {
+            // Register/value pairs in one burst; ctrl_hum latches on ctrl_meas write
+            const uint8_t cmd[4] = {
+                BME280_REG_CTRL_HUM, BME280_CTRL_HUM_X1,
+                BME280_REG_CTRL_MEAS, BME280_CTRL_MEAS_FORCED_X1
+            };
+            return i2c_write(bus, ACQ_BME280_ADDR, cmd, sizeof(cmd));
+        }
+        case ACQ_CH_BH1750: {
+            const uint8_t cmd = BH1750_ONE_TIME_H_RES;
+            return i2c_write(bus, ACQ_BH1750_ADDR, &cmd, 1);
+        }
+        case ACQ_CH_ADS1115: {
+            const uint8_t cmd[3] = {
+                ADS1115_REG_CONFIG,
+                ADS1115_CONFIG_SINGLE_AIN0 >> 8,
+                ADS1115_CONFIG_SINGLE_AIN0 & 0xFF
+            };
+            return i2c_write(bus, ACQ_ADS1115_ADDR, cmd, sizeof(cmd));
+        }
+        default:
+            return I2C_BUS_ERROR;
+    }
+}
+
+// Read back a finished conversion into the result
+static step_result_t collect_channel(acq_engine_t *engine, acq_channel_id_t id, int *err) {
+    const i2c_bus_t *bus = engine->bus;
+    acq_result_t *result = &engine->result;
+    uint8_t raw[8];
+
+    switch(id) {
+        case ACQ_CH_BME280:
+            *err = i2c_read_reg(bus, ACQ_BME280_ADDR, BME280_REG_DATA, raw, 8);
+            if(*err != I2C_OK) return STEP_ERROR;
+            bme280_compensate(raw, &result->temperature,
+                              &result->humidity, &result->pressure);
+            result->status |= ACQ_BME280_VALID;
+            return STEP_OK;
+
+        case ACQ_CH_BH1750:
+            *err = bus->transfer(bus->ctx, ACQ_BH1750_ADDR, NULL, 0, raw, 2);
+            if(*err != I2C_OK) return STEP_ERROR;
+            result->lux = (float)((raw[0] << 8) | raw[1]) / BH1750_LUX_DIVISOR;
+            result->status |= ACQ_BH1750_VALID;
+            return STEP_OK;
+
+        case ACQ_CH_ADS1115: {
+            // OS bit reads back 1 once the single-shot conversion is finished
+            *err = i2c_read_reg(bus, ACQ_ADS1115_ADDR, ADS1115_REG_CONFIG, raw, 2);
+            if(*err != I2C_OK) return STEP_ERROR;
+            if(!(((raw[0] << 8) | raw[1]) & ADS1115_OS_IDLE)) return STEP_NOT_READY;
+
+            *err = i2c_read_reg(bus, ACQ_ADS1115_ADDR, ADS1115_REG_CONVERSION, raw, 2);
+            if(*err != I2C_OK) return STEP_ERROR;
+            int16_t counts = (int16_t)((raw[0] << 8) | raw[1]);
+            result->soil_adc = counts > 0 ? (uint16_t)counts : 0;
+            result->status |= ACQ_ADS1115_VALID;
+            return STEP_OK;
+        }
+        default:
+            *err = I2C_BUS_ERROR;
+            return STEP_ERROR;
+    }
+}
+
+// Count a failed bus transaction; gives up after ACQ_MAX_RETRIES
+static void channel_error(acq_engine_t *engine, acq_channel_t *ch, int err, uint32_t now) {
+    ch->last_error = err;
+    if(++ch->attempts >= ACQ_MAX_RETRIES) {
+        ch->state = ACQ_CH_FAILED;
+        engine->pending--;
+    } else {
+        ch->ready_at = now + ACQ_RETRY_DELAY_MS;
+    }
+}
+
+// Initialize Acquisition Engine
+void acq_init(acq_engine_t *engine, const i2c_bus_t *bus, uint8_t enabled_mask) {
+    memset(engine, 0, sizeof(acq_engine_t));
+    engine->bus = bus;
+    engine->enabled = enabled_mask & ((1 << ACQ_CH_COUNT) - 1);
+}
+
+// Trigger every enabled conversion back-to-back so their wait times overlap
+bool acq_start(acq_engine_t *engine, acq_callback_t callback, void *user) {
+    if(acq_busy(engine) || engine->enabled == 0) {
+        return false;
+    }
+
+    uint32_t now = engine->bus->millis(engine->bus->ctx);
+    memset(&engine->result, 0, sizeof(acq_result_t));
+    engine->callback = callback;
+    engine->user = user;
+    engine->started_at = now;
+    engine->pending = 0;
+
+    for(int i = 0; i < ACQ_CH_COUNT; i++) {
+        acq_channel_t *ch = &engine->channels[i];
+        memset(ch, 0, sizeof(acq_channel_t));
+        if(!(engine->enabled & (1 << i))) continue;
+
+        engine->pending++;
+        int err = trigger_channel(engine->bus, (acq_channel_id_t)i);
+        if(err == I2C_OK) {
+            ch->state = ACQ_CH_CONVERTING;
+            ch->ready_at = now + conversion_ms[i];
+        } else {
+            // Trigger is repeated by acq_poll() once the retry delay expires
+            ch->state = ACQ_CH_IDLE;
+            channel_error(engine, ch, err, now);
+        }
+    }
+
+    // Everything may already have failed
+    acq_poll(engine);
+    return true;
+}
+
+/**
+ * Advance the acquisition state machine without blocking
+ *
+ * @param engine Acquisition engine
+ * @return True once the cycle is complete (callback has been invoked)
+ */
+bool acq_poll(acq_engine_t *engine) {
+    if(engine->callback == NULL && engine->pending == 0) {
+        return true;
+    }
+
+    const i2c_bus_t *bus = engine->bus;
+    uint32_t now = bus->millis(bus->ctx);
+
+    for(int i = 0; i < ACQ_CH_COUNT; i++) {
+        acq_channel_t *ch = &engine->channels[i];
+        if(!(engine->enabled & (1 << i))) continue;
+        if(ch->state == ACQ_CH_DONE || ch->state == ACQ_CH_FAILED) continue;
+        if(!time_reached(now, ch->ready_at)) continue;
+
+        int err = I2C_OK;
+        if(ch->state == ACQ_CH_IDLE) {
+            // Retry a trigger that was NACKed earlier
+            err = trigger_channel(bus, (acq_channel_id_t)i);
+            if(err == I2C_OK) {
+                ch->state = ACQ_CH_CONVERTING;
+                ch->ready_at = now + conversion_ms[i];
+            } else {
+                channel_error(engine, ch, err, now);
+            }
+            continue;
+        }
+
+        switch(collect_channel(engine, (acq_channel_id_t)i, &err)) {
+            case STEP_OK:
+                ch->state = ACQ_CH_DONE;
+                engine->pending--;
+                break;
+            case STEP_NOT_READY:
+                ch->ready_at = now + ACQ_NOT_READY_DELAY_MS;
+                break;
+            case STEP_ERROR:
+                channel_error(engine, ch, err, now);
+                break;
+        }
+    }
+
+    if(engine->pending > 0) {
+        return false;
+    }
+
+    if(engine->callback) {
+        acq_callback_t callback = engine->callback;
+        engine->callback = NULL;
+        engine->result.elapsed_ms = now - engine->started_at;
+        callback(&engine->result, engine->user);
+    }
+    return true;
+}
+
+// True while any conversion of the current cycle is outstanding
+bool acq_busy(const acq_engine_t *engine) {
+    return engine->pending > 0;
+}
+
+// Earliest bus time at which acq_poll() has work to do
+uint32_t acq_next_deadline(const acq_engine_t *engine) {
+    uint32_t now = engine->bus->millis(engine->bus->ctx);
+    uint32_t deadline = now;
+    bool found = false;
+
+    for(int i = 0; i < ACQ_CH_COUNT; i++) {
+        const acq_channel_t *ch = &engine->channels[i];
+        if(ch->state != ACQ_CH_CONVERTING && ch->state != ACQ_CH_IDLE) continue;
+        if(!(engine->enabled & (1 << i))) continue;
+
+        if(!found || (int32_t)(ch->ready_at - deadline) < 0) {
+            deadline = ch->ready_at;
+            found = true;
+        }
+    }
+    return deadline;
+}
+
+static void store_result(const acq_result_t *result, void *user) {
+    memcpy(user, result, sizeof(acq_result_t));
+}
+
+// Blocking acquisition; total time is bounded by the slowest conversion
+acq_result_t acq_read_all(acq_engine_t *engine) {
+    acq_result_t result;
+    memset(&result, 0, sizeof(result));
+
+    if(!acq_start(engine, store_result, &result)) {
+        return result;
+    }
+
+    while(!acq_poll(engine)) {
+        engine->bus->sleep_until(engine->bus->ctx, acq_next_deadline(engine));
+    }
+    return result;
+}
@@ -0,0 +1,80 @@
+#ifndef SENSOR_ACQUISITION_H
+#define SENSOR_ACQUISITION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "i2c_bus.h"
+
+// Default I2C addresses
+#define ACQ_BME280_ADDR 0x76
+#define ACQ_BH1750_ADDR 0x23
+#define ACQ_ADS1115_ADDR 0x48
+
+// Result status flags (set when the channel produced a valid reading)
+#define ACQ_BME280_VALID  0x01
+#define ACQ_BH1750_VALID  0x02
+#define ACQ_ADS1115_VALID 0x04
+#define ACQ_ALL_VALID     0x07
+
+// Read attempts per channel before it is reported as failed
+#define ACQ_MAX_RETRIES 3
+
+// Acquisition Channels
+typedef enum {
+    ACQ_CH_BME280 = 0,
+    ACQ_CH_BH1750 = 1,
+    ACQ_CH_ADS1115 = 2,
+    ACQ_CH_COUNT
+} acq_channel_id_t;
+
+// Channel State Machine
+typedef enum {
+    ACQ_CH_IDLE = 0,      // Not part of the current cycle
+    ACQ_CH_CONVERTING,    // Conversion triggered, waiting for ready_at
+    ACQ_CH_DONE,          // Result collected
+    ACQ_CH_FAILED         // Bus error after ACQ_MAX_RETRIES
+} acq_channel_state_t;
+
+// Acquisition Result
+typedef struct {
+    float temperature;    // °C
+    float humidity;       // %RH
+    float pressure;       // hPa
+    float lux;            // lx
+    uint16_t soil_adc;    // ADS1115 AIN0 raw count
+    uint8_t status;       // ACQ_*_VALID flags
+    uint32_t elapsed_ms;  // First trigger to last collection
+} acq_result_t;
+
+typedef void (*acq_callback_t)(const acq_result_t *result, void *user);
+
+typedef struct {
+    acq_channel_state_t state;
+    uint32_t ready_at;    // Bus time at which the conversion is complete
+    uint8_t attempts;
+    int last_error;
+} acq_channel_t;
+
+// Acquisition Engine
+typedef struct {
+    const i2c_bus_t *bus;
+    acq_channel_t channels[ACQ_CH_COUNT];
+    uint8_t enabled;          // Bitmask of (1 << acq_channel_id_t)
+    uint8_t pending;          // Channels still converting
+    uint32_t started_at;
+    acq_result_t result;
+    acq_callback_t callback;
+    void *user;
+} acq_engine_t;
+
+// Engine API
+void acq_init(acq_engine_t *engine, const i2c_bus_t *bus, uint8_t enabled_mask);
+bool acq_start(acq_engine_t *engine, acq_callback_t callback, void *user);
+bool acq_poll(acq_engine_t *engine);
+bool acq_busy(const acq_engine_t *engine);
+uint32_t acq_next_deadline(const acq_engine_t *engine);
+
+// Blocking convenience wrapper: start, sleep until each deadline, collect
+acq_result_t acq_read_all(acq_engine_t *engine);
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef SOIL_CAL_BLOB_H
+#define SOIL_CAL_BLOB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Per-Probe Calibration Blob
+// Produced by hardware/calibration/tools/soil_cal_fit. The ADC reading is
+// normalized before evaluation, x = (adc - adc_center) / adc_scale, which
+// keeps the cubic well conditioned in single precision:
+//   vwc = p0 + p1*x + p2*x^2 + p3*x^3 + (k0 + k1*x) * (temp - t_ref)
+
+#define SOIL_CAL_MAGIC 0x4C414353u   // "SCAL"
+#define SOIL_CAL_VERSION 1
+
+// Flags
+#define SOIL_CAL_TEMP_FITTED 0x0001  // k0/k1 fitted (else k0 from nominal)
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t flags;
+    char probe_id[16];
+    float adc_center;
+    float adc_scale;
+    float t_ref;          // °C
+    float poly[4];        // p0..p3
+    float temp[2];        // k0 (%VWC/°C), k1 (%VWC/°C per unit x)
+    float rmse;           // Fit residual (%VWC)
+    float max_error;
+    uint16_t points;
+    uint16_t reserved;
+    uint32_t crc32;       // Over all preceding bytes
+} soil_cal_blob_t;
+
+static inline uint32_t soil_cal_crc32(const uint8_t *data, size_t len) {
+    uint32_t crc = 0xFFFFFFFFu;
+    for(size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for(int b = 0; b < 8; b++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+    }
+    return ~crc;
+}
+
+static inline bool soil_cal_blob_valid(const soil_cal_blob_t *blob) {
+    return blob->magic == SOIL_CAL_MAGIC &&
+           blob->version == SOIL_CAL_VERSION &&
+           blob->adc_scale != 0.0f &&
+           blob->crc32 == soil_cal_crc32((const uint8_t *)blob,
+                                         offsetof(soil_cal_blob_t, crc32));
+}
+
+static inline float soil_cal_evaluate(const soil_cal_blob_t *blob, uint16_t adc, float temp) {
+    float x = ((float)adc - blob->adc_center) / blob->adc_scale;
+    float vwc = blob->poly[0] + x * (blob->poly[1] + x * (blob->poly[2] + x * blob->poly[3]));
+    return vwc + (blob->temp[0] + blob->temp[1] * x) * (temp - blob->t_ref);
+}
+
+#endif
@@ -2,6 +2,7 @@
 #define SOIL_MOISTURE_H
 
 #include <stdint.h>
+#include "soil_cal_blob.h"
 
 // Sensor status codes
 #define SENSOR_OK 0
@@ -17,5 +18,6 @@ int sensor_diagnostics(uint16_t adc_value);
 void set_dry_calibration(float value);
 void set_wet_calibration(float value);
 void set_temp_coefficient(float coeff);
+bool set_calibration_blob(const soil_cal_blob_t *blob);   // False if CRC/version invalid
 
 #endif
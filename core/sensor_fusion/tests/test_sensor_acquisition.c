@@ -0,0 +1,140 @@
+// Host tests for the pipelined acquisition engine on the simulated bus
+//   cc -I.. test_sensor_acquisition.c ../sensor_acquisition.c ../i2c_bus_sim.c -o test_sensor_acquisition
+
+#include "sensor_acquisition.h"
+#include "i2c_bus_sim.h"
+#include <stdio.h>
+
+#define BH1750_CONV_MAX_MS 180
+#define SERIAL_CONV_MS (10 + 180 + 9)
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if(!(cond)) { \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while(0)
+
+// Compensation lives in the BME280 driver; fixed values are enough here
+void bme280_compensate(const uint8_t *raw, float *temp, float *hum, float *pres) {
+    (void)raw;
+    *temp = 21.0f;
+    *hum = 50.0f;
+    *pres = 1013.0f;
+}
+
+static void setup(i2c_sim_t *sim, i2c_bus_t *bus, acq_engine_t *engine) {
+    i2c_sim_init(sim, bus);
+    i2c_sim_add_default_sensors(sim);
+    acq_init(engine, bus, ACQ_ALL_VALID);
+}
+
+// Conversions overlap: one cycle costs the slowest sensor, not the sum
+static void test_cycle_time(void) {
+    i2c_sim_t sim;
+    i2c_bus_t bus;
+    acq_engine_t engine;
+    setup(&sim, &bus, &engine);
+
+    acq_result_t r = acq_read_all(&engine);
+    CHECK(r.status == ACQ_ALL_VALID);
+    CHECK(r.elapsed_ms >= BH1750_CONV_MAX_MS);
+    CHECK(r.elapsed_ms <= BH1750_CONV_MAX_MS + 2);
+    CHECK(r.elapsed_ms < SERIAL_CONV_MS);
+    CHECK(r.soil_adc == 2100);
+    CHECK(sim.errors == 0);
+
+    // Same with a non-zero per-transaction bus cost
+    setup(&sim, &bus, &engine);
+    sim.transfer_cost_ms = 1;
+    r = acq_read_all(&engine);
+    CHECK(r.status == ACQ_ALL_VALID);
+    CHECK(r.elapsed_ms < SERIAL_CONV_MS);
+}
+
+// NACKs below the retry limit are absorbed
+static void test_nack_recovery(void) {
+    i2c_sim_t sim;
+    i2c_bus_t bus;
+    acq_engine_t engine;
+    setup(&sim, &bus, &engine);
+
+    i2c_sim_inject_errors(&sim.devices[ACQ_CH_BME280], ACQ_MAX_RETRIES - 1, I2C_NACK);
+    acq_result_t r = acq_read_all(&engine);
+    CHECK(r.status == ACQ_ALL_VALID);
+    CHECK(engine.channels[ACQ_CH_BME280].state == ACQ_CH_DONE);
+    CHECK(engine.channels[ACQ_CH_BME280].attempts == ACQ_MAX_RETRIES - 1);
+    CHECK(r.elapsed_ms < SERIAL_CONV_MS);
+}
+
+// A channel that keeps failing is dropped without holding up the others
+static void test_retry_limit(void) {
+    i2c_sim_t sim;
+    i2c_bus_t bus;
+    acq_engine_t engine;
+    setup(&sim, &bus, &engine);
+
+    i2c_sim_inject_errors(&sim.devices[ACQ_CH_ADS1115], ACQ_MAX_RETRIES, I2C_TIMEOUT);
+    acq_result_t r = acq_read_all(&engine);
+    CHECK(r.status == (ACQ_BME280_VALID | ACQ_BH1750_VALID));
+    CHECK(engine.channels[ACQ_CH_ADS1115].state == ACQ_CH_FAILED);
+    CHECK(engine.channels[ACQ_CH_ADS1115].last_error == I2C_TIMEOUT);
+    CHECK(engine.channels[ACQ_CH_ADS1115].attempts == ACQ_MAX_RETRIES);
+    CHECK(!acq_busy(&engine));
+
+    // The next cycle starts clean
+    r = acq_read_all(&engine);
+    CHECK(r.status == ACQ_ALL_VALID);
+}
+
+// Every trigger failing completes the cycle instead of hanging
+static void test_all_triggers_fail(void) {
+    i2c_sim_t sim;
+    i2c_bus_t bus;
+    acq_engine_t engine;
+    setup(&sim, &bus, &engine);
+
+    for(int i = 0; i < ACQ_CH_COUNT; i++) {
+        i2c_sim_inject_errors(&sim.devices[i], ACQ_MAX_RETRIES, I2C_BUS_ERROR);
+    }
+
+    acq_result_t r = acq_read_all(&engine);
+    CHECK(r.status == 0);
+    CHECK(!acq_busy(&engine));
+    for(int i = 0; i < ACQ_CH_COUNT; i++) {
+        CHECK(engine.channels[i].state == ACQ_CH_FAILED);
+        CHECK(engine.channels[i].last_error == I2C_BUS_ERROR);
+    }
+    CHECK(sim.errors == ACQ_CH_COUNT * ACQ_MAX_RETRIES);
+}
+
+// A failed trigger is retried from acq_poll()
+static void test_trigger_retry(void) {
+    i2c_sim_t sim;
+    i2c_bus_t bus;
+    acq_engine_t engine;
+    setup(&sim, &bus, &engine);
+
+    i2c_sim_inject_errors(&sim.devices[ACQ_CH_BH1750], 1, I2C_NACK);
+    acq_result_t r = acq_read_all(&engine);
+    CHECK(r.status == ACQ_ALL_VALID);
+    CHECK(engine.channels[ACQ_CH_BH1750].attempts == 1);
+    CHECK(r.elapsed_ms < SERIAL_CONV_MS);
+}
+
+int main(void) {
+    test_cycle_time();
+    test_nack_recovery();
+    test_retry_limit();
+    test_all_triggers_fail();
+    test_trigger_retry();
+
+    if(failures) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("sensor_acquisition: all tests passed\n");
+    return 0;
+}
@@ -0,0 +1,383 @@
+// Batch soil probe calibration fitter
+//
+// Reads calibration-point files (format of data/soil_vwc_cal.json), fits a
+// cubic VWC curve plus a temperature-compensation surface per probe with
+// least squares, and writes one soil_cal_blob_t per probe for the firmware.
+//
+// Build:
+//   cc -O2 -I../../../core/sensor_fusion soil_cal_fit.c -lcjson -lpthread -lm -o soil_cal_fit
+// Usage:
+//   soil_cal_fit [-j threads] [-o out_dir] [--bench repeat] probe1.json probe2.json ...
+
+#include "soil_cal_blob.h"
+#include <cJSON.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_POINTS 256
+#define MAX_PARAMS 6
+#define T_REF 25.0
+#define T_SCALE 10.0            // Temperature normalization for conditioning
+#define MIN_TEMP_SPAN 2.0       // °C spread needed to fit the temperature surface
+#define MAX_THREADS 256
+
+typedef struct {
+    char path[256];
+    char probe_id[16];
+    float nominal_temp_coeff;   // "temperature_compensation" from the file
+    int count;
+    // Column layout keeps the normal-equation loops vectorizable
+    double adc[MAX_POINTS];
+    double temp[MAX_POINTS];
+    double vwc[MAX_POINTS];
+} probe_points_t;
+
+typedef struct {
+    soil_cal_blob_t blob;
+    int params;
+    bool ok;
+    char error[64];
+} probe_fit_t;
+
+typedef struct {
+    const probe_points_t *probes;
+    size_t inputs;              // Distinct probes; fits wrap around them
+    probe_fit_t *fits;
+    size_t count;
+    atomic_size_t next;
+} fit_job_t;
+
+// Input
+
+static char *read_file(const char *path) {
+    FILE *fp = fopen(path, "rb");
+    if(!fp) return NULL;
+
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    char *buf = malloc(size + 1);
+    if(buf && fread(buf, 1, size, fp) == (size_t)size) {
+        buf[size] = '\0';
+    } else {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(fp);
+    return buf;
+}
+
+static void probe_id_from_path(const char *path, char *id, size_t len) {
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    snprintf(id, len, "%s", base);
+    char *dot = strrchr(id, '.');
+    if(dot) *dot = '\0';
+}
+
+static bool load_probe(const char *path, probe_points_t *probe) {
+    memset(probe, 0, sizeof(probe_points_t));
+    snprintf(probe->path, sizeof(probe->path), "%s", path);
+
+    char *text = read_file(path);
+    if(!text) return false;
+
+    cJSON *root = cJSON_Parse(text);
+    free(text);
+    if(!root) return false;
+
+    cJSON *id = cJSON_GetObjectItem(root, "probe_id");
+    if(cJSON_IsString(id)) {
+        snprintf(probe->probe_id, sizeof(probe->probe_id), "%s", id->valuestring);
+    } else {
+        probe_id_from_path(path, probe->probe_id, sizeof(probe->probe_id));
+    }
+
+    cJSON *tc = cJSON_GetObjectItem(root, "temperature_compensation");
+    probe->nominal_temp_coeff = cJSON_IsNumber(tc) ? (float)tc->valuedouble : 0.0f;
+
+    cJSON *point;
+    cJSON_ArrayForEach(point, cJSON_GetObjectItem(root, "calibration_points")) {
+        if(probe->count >= MAX_POINTS) break;
+        cJSON *adc = cJSON_GetObjectItem(point, "raw_adc");
+        cJSON *vwc = cJSON_GetObjectItem(point, "vwc");
+        cJSON *temp = cJSON_GetObjectItem(point, "temperature");
+        if(!cJSON_IsNumber(adc) || !cJSON_IsNumber(vwc)) continue;
+
+        probe->adc[probe->count] = adc->valuedouble;
+        probe->vwc[probe->count] = vwc->valuedouble;
+        probe->temp[probe->count] = cJSON_IsNumber(temp) ? temp->valuedouble : T_REF;
+        probe->count++;
+    }
+
+    cJSON_Delete(root);
+    return true;
+}
+
+// Fitting
+
+// Solve the SPD system A x = b in place (Cholesky); false if singular
+static bool cholesky_solve(double a[MAX_PARAMS][MAX_PARAMS], double *b, int n) {
+    for(int j = 0; j < n; j++) {
+        double d = a[j][j];
+        for(int k = 0; k < j; k++) d -= a[j][k] * a[j][k];
+        if(d <= 1e-12) return false;
+        a[j][j] = sqrt(d);
+
+        for(int i = j + 1; i < n; i++) {
+            double s = a[i][j];
+            for(int k = 0; k < j; k++) s -= a[i][k] * a[j][k];
+            a[i][j] = s / a[j][j];
+        }
+    }
+
+    for(int i = 0; i < n; i++) {
+        for(int k = 0; k < i; k++) b[i] -= a[i][k] * b[k];
+        b[i] /= a[i][i];
+    }
+    for(int i = n - 1; i >= 0; i--) {
+        for(int k = i + 1; k < n; k++) b[i] -= a[k][i] * b[k];
+        b[i] /= a[i][i];
+    }
+    return true;
+}
+
+/**
+ * Fit one probe
+ *
+ * Columns: 1, x, x^2, x^3, t, x*t with x = (adc - mean)/half_range and
+ * t = (temp - T_REF)/T_SCALE. The temperature columns are dropped (and the
+ * nominal coefficient kept) when the points do not span enough temperature.
+ */
+static void fit_probe(const probe_points_t *p, probe_fit_t *fit) {
+    memset(fit, 0, sizeof(probe_fit_t));
+    int n = p->count;
+
+    if(n < 4) {
+        snprintf(fit->error, sizeof(fit->error), "need >= 4 points, have %d", n);
+        return;
+    }
+
+    double adc_min = p->adc[0], adc_max = p->adc[0], adc_sum = 0;
+    double t_min = p->temp[0], t_max = p->temp[0];
+    for(int i = 0; i < n; i++) {
+        adc_sum += p->adc[i];
+        adc_min = fmin(adc_min, p->adc[i]);
+        adc_max = fmax(adc_max, p->adc[i]);
+        t_min = fmin(t_min, p->temp[i]);
+        t_max = fmax(t_max, p->temp[i]);
+    }
+
+    double center = adc_sum / n;
+    double scale = (adc_max - adc_min) / 2.0;
+    if(scale <= 0) {
+        snprintf(fit->error, sizeof(fit->error), "no ADC spread");
+        return;
+    }
+
+    bool fit_temp = (t_max - t_min) >= MIN_TEMP_SPAN && n >= MAX_PARAMS + 1;
+    int m = fit_temp ? MAX_PARAMS : 4;
+    double k0_nominal = fit_temp ? 0.0 : p->nominal_temp_coeff;
+
+    // Design matrix, column-major
+    double cols[MAX_PARAMS][MAX_POINTS];
+    double y[MAX_POINTS];
+    for(int i = 0; i < n; i++) {
+        double x = (p->adc[i] - center) / scale;
+        double t = (p->temp[i] - T_REF) / T_SCALE;
+        cols[0][i] = 1.0;
+        cols[1][i] = x;
+        cols[2][i] = x * x;
+        cols[3][i] = x * x * x;
+        cols[4][i] = t;
+        cols[5][i] = x * t;
+        // Fixed nominal compensation moves to the target side
+        y[i] = p->vwc[i] - k0_nominal * (p->temp[i] - T_REF);
+    }
+
+    // Normal equations A = X^T X, b = X^T y
+    double a[MAX_PARAMS][MAX_PARAMS];
+    double b[MAX_PARAMS];
+    for(int r = 0; r < m; r++) {
+        for(int c = 0; c <= r; c++) {
+            double s = 0;
+            for(int i = 0; i < n; i++) s += cols[r][i] * cols[c][i];
+            a[r][c] = a[c][r] = s;
+        }
+        double s = 0;
+        for(int i = 0; i < n; i++) s += cols[r][i] * y[i];
+        b[r] = s;
+    }
+
+    if(!cholesky_solve(a, b, m)) {
+        snprintf(fit->error, sizeof(fit->error), "singular system");
+        return;
+    }
+
+    // Residuals against the full model
+    double sq = 0, worst = 0;
+    for(int i = 0; i < n; i++) {
+        double pred = 0;
+        for(int c = 0; c < m; c++) pred += b[c] * cols[c][i];
+        double r = y[i] - pred;
+        sq += r * r;
+        worst = fmax(worst, fabs(r));
+    }
+
+    soil_cal_blob_t *blob = &fit->blob;
+    blob->magic = SOIL_CAL_MAGIC;
+    blob->version = SOIL_CAL_VERSION;
+    blob->flags = fit_temp ? SOIL_CAL_TEMP_FITTED : 0;
+    memcpy(blob->probe_id, p->probe_id, sizeof(blob->probe_id));
+    blob->adc_center = (float)center;
+    blob->adc_scale = (float)scale;
+    blob->t_ref = (float)T_REF;
+    for(int c = 0; c < 4; c++) blob->poly[c] = (float)b[c];
+    blob->temp[0] = fit_temp ? (float)(b[4] / T_SCALE) : (float)k0_nominal;
+    blob->temp[1] = fit_temp ? (float)(b[5] / T_SCALE) : 0.0f;
+    blob->rmse = (float)sqrt(sq / n);
+    blob->max_error = (float)worst;
+    blob->points = (uint16_t)n;
+    blob->crc32 = soil_cal_crc32((const uint8_t *)blob, offsetof(soil_cal_blob_t, crc32));
+
+    fit->params = m;
+    fit->ok = true;
+}
+
+static void *fit_worker(void *arg) {
+    fit_job_t *job = (fit_job_t *)arg;
+    size_t i;
+    while((i = atomic_fetch_add(&job->next, 1)) < job->count) {
+        fit_probe(&job->probes[i % job->inputs], &job->fits[i]);
+    }
+    return NULL;
+}
+
+// The calling thread fits too, so every probe is done even if no worker starts.
+// Returns the number of threads that took part.
+static int fit_all(fit_job_t *job, int threads) {
+    pthread_t workers[MAX_THREADS - 1];
+    int started = 0;
+    atomic_store(&job->next, 0);
+
+    while(started < threads - 1) {
+        if(pthread_create(&workers[started], NULL, fit_worker, job) != 0) {
+            fprintf(stderr, "warning: started %d of %d threads\n", started + 1, threads);
+            break;
+        }
+        started++;
+    }
+    fit_worker(job);
+    for(int t = 0; t < started; t++) {
+        pthread_join(workers[t], NULL);
+    }
+    return started + 1;
+}
+
+// Output
+
+static bool write_blob(const char *out_dir, const soil_cal_blob_t *blob) {
+    char path[512];
+    char id[sizeof(blob->probe_id) + 1] = {0};
+    memcpy(id, blob->probe_id, sizeof(blob->probe_id));
+    snprintf(path, sizeof(path), "%s/%s.scal", out_dir, id);
+
+    FILE *fp = fopen(path, "wb");
+    if(!fp) return false;
+    bool ok = fwrite(blob, sizeof(soil_cal_blob_t), 1, fp) == 1;
+    fclose(fp);
+    return ok;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-j threads] [-o out_dir] [--bench repeat] files...\n", prog);
+}
+
+int main(int argc, char **argv) {
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    const char *out_dir = ".";
+    int bench = 0;
+    int first = 1;
+
+    for(; first < argc && argv[first][0] == '-'; first++) {
+        if(strcmp(argv[first], "-j") == 0 && first + 1 < argc) {
+            threads = atoi(argv[++first]);
+        } else if(strcmp(argv[first], "-o") == 0 && first + 1 < argc) {
+            out_dir = argv[++first];
+        } else if(strcmp(argv[first], "--bench") == 0 && first + 1 < argc) {
+            bench = atoi(argv[++first]);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if(first >= argc) {
+        usage(argv[0]);
+        return 2;
+    }
+    if(threads < 1) threads = 1;
+    if(threads > MAX_THREADS) threads = MAX_THREADS;
+
+    size_t files = argc - first;
+    size_t repeat = bench > 0 ? (size_t)bench : 1;
+    size_t count = files * repeat;
+
+    probe_points_t *probes = malloc(files * sizeof(probe_points_t));
+    probe_fit_t *fits = malloc(count * sizeof(probe_fit_t));
+    if(!probes || !fits) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    for(size_t f = 0; f < files; f++) {
+        if(!load_probe(argv[first + f], &probes[f])) {
+            fprintf(stderr, "%s: cannot parse\n", argv[first + f]);
+            probes[f].count = 0;
+        }
+    }
+    // Benchmark mode fits every input `repeat` times for a measurable workload
+    fit_job_t job = { .probes = probes, .inputs = files, .fits = fits, .count = count };
+    double start = now_seconds();
+    threads = fit_all(&job, threads);
+    double elapsed = now_seconds() - start;
+
+    if(bench > 0) {
+        printf("fitted %zu probes on %d threads in %.3f s (%.0f probes/s)\n",
+               count, threads, elapsed, count / elapsed);
+        free(probes);
+        free(fits);
+        return 0;
+    }
+
+    int failures = 0;
+    printf("probe_id,points,params,rmse,max_error,k0,k1,status\n");
+    for(size_t i = 0; i < files; i++) {
+        const probe_fit_t *fit = &fits[i];
+        if(!fit->ok || !write_blob(out_dir, &fit->blob)) {
+            printf("%s,%d,0,,,,,%s\n", probes[i].probe_id, probes[i].count,
+                   fit->ok ? "write failed" : fit->error);
+            failures++;
+            continue;
+        }
+        printf("%s,%u,%d,%.3f,%.3f,%.4f,%.4f,ok\n", probes[i].probe_id, fit->blob.points,
+               fit->params, fit->blob.rmse, fit->blob.max_error,
+               fit->blob.temp[0], fit->blob.temp[1]);
+    }
+
+    free(probes);
+    free(fits);
+    return failures ? 1 : 0;
+}